@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <QtTest>
+
+#include "analyticsmanager.h"
+#include "hitbuilder.h"
+#include "hitparameters.h"
+#include "iplatforminfo.h"
+#include "loopbacktransport.h"
+#include "tracker.h"
+
+#include <climits>
+#include <cstdlib>
+#include <new>
+
+QTANALYTICS_NAMESPACE_USING
+
+// Every allocation of the process is counted, benchmarks read the difference around a stage
+static QAtomicInteger<quint64> g_allocationCount(0);
+
+void* operator new(std::size_t size)
+{
+    g_allocationCount.fetchAndAddRelaxed(1);
+    if (void* pMemory = std::malloc(size ? size : 1))
+    {
+        return pMemory;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pMemory) noexcept
+{
+    std::free(pMemory);
+}
+
+void operator delete(void* pMemory, std::size_t) noexcept
+{
+    std::free(pMemory);
+}
+
+///
+/// \brief Platform information with fixed values, so no window system is needed.
+///
+class CBenchmarkPlatformInfo : public IPlatformInfo
+{
+public:
+    QString getAnonymousClientId() const override { return QString("35009a79-1a05-49d7-b876-2b884d0f825b"); }
+    Dimensions getViewPortResolution() const override { return Dimensions { 1280, 720 }; }
+    Dimensions getScreenResolution() const override { return Dimensions { 1920, 1080 }; }
+    int getScreenColors() const override { return 24; }
+    QString getUserLanguage() const override { return QString("en-us"); }
+    QString getUserAgent() const override { return QString("QtAnalytics benchmark"); }
+
+    TPlatformSnapshotPtr getSnapshot() const override
+    {
+        static TPlatformSnapshotPtr pSnapshot(new CPlatformSnapshot(getScreenResolution(), getViewPortResolution(), getScreenColors(), getUserLanguage(), getUserAgent()));
+        return pSnapshot;
+    }
+};
+
+///
+/// \brief Manager which takes hits without queueing them, to measure the tracker alone.
+///
+class CNullAnalyticsManager : public IAnalyticsManager
+{
+public:
+    void enqueueHit(const QMap<QString, QString> &) override {}
+    void enqueueHit(const CHit &) override {}
+    int adaptiveSampleFactor() const override { return 1000; }
+};
+
+///
+/// \brief The builder as it was before it became a flat accumulator, kept as the baseline of builderEvent.
+///
+/// Every setter returns a new builder which copies the lineage of pointers to its ancestors and
+/// a map of its own values, build merges the maps of the lineage. A chain is only valid within
+/// one full expression, while the temporaries are alive.
+///
+class CBaselineHitBuilder
+{
+public:
+    explicit CBaselineHitBuilder(const QMap<QString, QString> &data)
+    {
+        m_lineage.append(this);
+        for (QMap<QString, QString>::const_iterator it = data.begin(), end = data.end(); it != end; ++it)
+        {
+            m_data.insert(it.key(), it.value());
+        }
+    }
+
+    CBaselineHitBuilder(const QVector<CBaselineHitBuilder*> &lineage, const QMap<QString, QString> &data)
+    {
+        for (QVector<CBaselineHitBuilder*>::const_iterator it = lineage.begin(), end = lineage.end(); it != end; ++it)
+        {
+            m_lineage.append(*it);
+        }
+        m_lineage.append(this);
+
+        for (QMap<QString, QString>::const_iterator it = data.begin(), end = data.end(); it != end; ++it)
+        {
+            m_data.insert(it.key(), it.value());
+        }
+    }
+
+    static CBaselineHitBuilder createCustomEvent(QString category, QString action, QString label, long long value)
+    {
+        QMap<QString, QString> data;
+        data.insert("t", "event");
+        data.insert("ec", category);
+        data.insert("ea", action);
+
+        if (!label.isEmpty()) data.insert("el", label);
+        if (value) data.insert("ev", QString("%1").arg(value));
+
+        return CBaselineHitBuilder(data);
+    }
+
+    CBaselineHitBuilder setValue(const QString &paramName, const QString &paramValue)
+    {
+        QMap<QString, QString> data;
+        data.insert(paramName, paramValue);
+
+        return CBaselineHitBuilder(m_lineage, data);
+    }
+
+    QMap<QString, QString> build()
+    {
+        QMap<QString, QString> data;
+        for (QVector<CBaselineHitBuilder*>::iterator lineageIt = m_lineage.begin(), end = m_lineage.end(); lineageIt != end; ++lineageIt)
+        {
+            CBaselineHitBuilder* pCurrent = *lineageIt;
+            for (QMap<QString, QString>::const_iterator it = pCurrent->m_data.begin(), end = pCurrent->m_data.end(); it != end; ++it)
+            {
+                data.insert(it.key(), it.value());
+            }
+        }
+
+        return data;
+    }
+
+private:
+    QVector<CBaselineHitBuilder*> m_lineage;
+    QMap<QString, QString> m_data;
+};
+
+///
+/// \brief Cost of every stage of the hit pipeline, from building a hit to its delivery.
+///
+/// Time is reported by QBENCHMARK per iteration, allocations per operation are printed
+/// after each benchmark. Delivery goes through CLoopbackTransport, so no network is used.
+///
+class CBenchHitPipeline : public QObject
+{
+    Q_OBJECT
+
+private:
+    template<typename TFunction>
+    static void reportAllocations(const char* pStage, TFunction function)
+    {
+        const int iterations = 1000;
+
+        quint64 before = g_allocationCount.loadAcquire();
+        for (int i = 0; i < iterations; i++)
+        {
+            function();
+        }
+        quint64 after = g_allocationCount.loadAcquire();
+
+        qInfo("%s: %.2f allocations/op", pStage, static_cast<double>(after - before) / iterations);
+    }
+
+    static CHitParameters createEventHit()
+    {
+        return CHitBuilder::createCustomEvent("Video", "Play", "Intro", 42)
+            .setCustomDimension(1, "premium")
+            .setCustomMetric(2, 3)
+            .setNonInteraction()
+            .build();
+    }
+
+    static QMap<QString, QString> createBaselineEventHit()
+    {
+        return CBaselineHitBuilder::createCustomEvent("Video", "Play", "Intro", 42)
+            .setValue(QString("cd%1").arg(1), "premium")
+            .setValue(QString("cm%1").arg(2), QString("%1").arg(3))
+            .setValue("ni", "1")
+            .build();
+    }
+
+    CBenchmarkPlatformInfo m_platformInfo;
+
+private slots:
+    void builderScreenView()
+    {
+        QBENCHMARK
+        {
+            CHitParameters params = CHitBuilder::createScreenView("Main").build();
+            Q_UNUSED(params)
+        }
+
+        reportAllocations("builderScreenView", []() { CHitBuilder::createScreenView("Main").build(); });
+    }
+
+    void builderEvent()
+    {
+        QBENCHMARK
+        {
+            CHitParameters params = createEventHit();
+            Q_UNUSED(params)
+        }
+
+        reportAllocations("builderEvent", []() { createEventHit(); });
+    }
+
+    void builderEventBaseline()
+    {
+        // Same hit as builderEvent, built the way it was before, to compare both in one run
+        QBENCHMARK
+        {
+            QMap<QString, QString> params = createBaselineEventHit();
+            Q_UNUSED(params)
+        }
+
+        reportAllocations("builderEventBaseline", []() { createBaselineEventHit(); });
+    }
+
+    void encodeParameters()
+    {
+        CHitParameters params = createEventHit();
+
+        QBENCHMARK
+        {
+            QByteArray payload;
+            params.encode(payload);
+        }
+
+        reportAllocations("encodeParameters", [&params]() { QByteArray payload; params.encode(payload); });
+    }
+
+    void encodeMap()
+    {
+        QMap<QString, QString> params = createEventHit().toMap();
+
+        QBENCHMARK
+        {
+            CHit hit(params);
+            Q_UNUSED(hit)
+        }
+
+        reportAllocations("encodeMap", [&params]() { CHit hit(params); });
+    }
+
+    void trackerSend()
+    {
+        // Adds the common parameters of the tracker, the hit itself is discarded
+        CNullAnalyticsManager analyticsManager;
+        QString propertyId("UA-12345-1");
+        CTracker tracker(propertyId, &m_platformInfo, &analyticsManager);
+        tracker.AppName = "Benchmark";
+        tracker.AppVersion = "1.0";
+        tracker.RateLimitRefill = 0.0;
+
+        CHitParameters params = createEventHit();
+
+        QBENCHMARK
+        {
+            tracker.send(params);
+        }
+
+        reportAllocations("trackerSend", [&tracker, &params]() { tracker.send(params); });
+    }
+
+    void managerEnqueueHit()
+    {
+        CAnalyticsManager analyticsManager(new CBenchmarkPlatformInfo());
+        CLoopbackTransport* pTransport = new CLoopbackTransport();
+        analyticsManager.setTransport(pTransport);
+        analyticsManager.RateLimitRefill = 0.0;
+        analyticsManager.MaxQueueSize = INT_MAX;
+
+        CHit hit(createEventHit().toMap());
+
+        QBENCHMARK
+        {
+            analyticsManager.enqueueHit(hit);
+        }
+
+        reportAllocations("managerEnqueueHit", [&analyticsManager, &hit]() { analyticsManager.enqueueHit(hit); });
+    }
+
+    void deliverBatches()
+    {
+        // Throughput from the tracker to the transport, including the sender thread
+        CAnalyticsManager analyticsManager(new CBenchmarkPlatformInfo());
+        CLoopbackTransport* pTransport = new CLoopbackTransport();
+        analyticsManager.setTransport(pTransport);
+        analyticsManager.BatchHits = true;
+        analyticsManager.RateLimitRefill = 0.0;
+
+        CTracker* pTracker = analyticsManager.createTracker("UA-12345-1");
+        pTracker->RateLimitRefill = 0.0;
+
+        CHitParameters params = createEventHit();
+        const int hitCount = 1000;
+
+        QBENCHMARK
+        {
+            quint64 target = pTransport->hitCount() + hitCount;
+            for (int i = 0; i < hitCount; i++)
+            {
+                pTracker->send(params);
+            }
+
+            QTRY_VERIFY_WITH_TIMEOUT(pTransport->hitCount() >= target, 10000);
+        }
+    }
+};
+
+QTEST_MAIN(CBenchHitPipeline)
+
+#include "benchhitpipeline.moc"
@@ -19,37 +19,29 @@
  */
 
 #include "analyticsmanager.h"
+#include "crashrecorder.h"
+#include "hitdispatcher.h"
 #include "platforminfo.h"
 
-#include <QUrlQuery>
 #include <QSettings>
-#include <QApplication>
-
-#include <QRandomGenerator>
-
-#include <QNetworkReply>
-#include <QNetworkRequest>
+#include <QCoreApplication>
 
 QTANALYTICS_NAMESPACE_USING
 
 QString CAnalyticsManager::m_keyAppOptOut = "AppOptOut";
 CAnalyticsManager* CAnalyticsManager::m_pInstance = Q_NULLPTR;
-
-QString CAnalyticsManager::m_endPointUnsecureDebug = QString("http://www.google-analytics.com/debug/collect");
-QString CAnalyticsManager::m_endPointSecureDebug = QString("https://ssl.google-analytics.com/debug/collect");
-QString CAnalyticsManager::m_endPointUnsecure = QString("http://www.google-analytics.com/collect");
-QString CAnalyticsManager::m_endPointSecure = QString("https://ssl.google-analytics.com/collect");
+CAnalyticsManager::TPlatformInfoFactory CAnalyticsManager::m_platformInfoFactory = &CAnalyticsManager::createPlatformInfo;
 
 CAnalyticsManager::CAnalyticsManager(IPlatformInfo* pPlatformInfo, QObject* pParent)
     : QObject(pParent)
     , m_autoTrackNetworkConnectivity(false)
-    , m_isAppOptOutSet(false)
-    , m_appOptOut(false)
+    , m_appOptOut(0)
     , m_pPlatformInfo(pPlatformInfo)
     , m_pNetworkConfigurationManager(new QNetworkConfigurationManager(this))
-    , m_pNetworkAccessManager(new QNetworkAccessManager(this))
     , m_pDefaultTracker(Q_NULLPTR)
-    , m_isSending(false)
+    , m_pMetrics(new CAnalyticsMetrics(this))
+    , m_pSenderThread(new QThread(this))
+    , m_pDispatcher(Q_NULLPTR)
 {
     // Setup default values
     IsEnabled = true;
@@ -57,13 +49,50 @@ CAnalyticsManager::CAnalyticsManager(IPlatformInfo* pPlatformInfo, QObject* pPar
     IsDebug = false;
     PostData = true;
     BustCache = false;
-
-    // Connect internal signals
-    connect(this, &CAnalyticsManager::sendNextHit, this, &CAnalyticsManager::onSendHit);
+    BatchHits = false;
+    MaxInFlight = 6;
+    MaxRetries = 8;
+    RetryBaseDelay = 1000;
+    RetryMaxDelay = 300000;
+    MaxQueueSize = 10000;
+    MaxQueueBytes = 8 * 1024 * 1024;
+    OverflowPolicy = EOverflowPolicy_DropOldest;
+    MaxHitAge = (4 * 60 - 5) * 60 * 1000;
+    AdaptiveQueueDepth = 1000;
+    AdaptiveSendLatency = 2000;
+    RateLimitBurst = 60;
+    RateLimitRefill = 0.0;
+    RateLimitPolicy = CTokenBucket::EPolicy_Shape;
+    ShutdownFlushTimeout = 2000;
+    PreConnect = true;
+
+    // Resolved here, so no other thread ever touches the settings store
+    loadAppOptOut();
+
+    // Network access, encoding and reply handling run in the sender thread
+    m_appliedSettings = settings();
+    m_pDispatcher = new CHitDispatcher(this, m_appliedSettings);
+
+    m_pSenderThread->setObjectName("QtAnalytics sender");
+    m_pDispatcher->moveToThread(m_pSenderThread);
+    connect(m_pDispatcher, &CHitDispatcher::backpressureChanged, this, &CAnalyticsManager::backpressureChanged);
+    connect(m_pSenderThread, &QThread::finished, m_pDispatcher, &QObject::deleteLater);
+    m_pSenderThread->start();
+
+    // The first hit should not pay for the handshake
+    QMetaObject::invokeMethod(m_pDispatcher, "warmUp", Qt::QueuedConnection);
+
+    if (QCoreApplication::instance())
+    {
+        connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, &CAnalyticsManager::onAboutToQuit);
+    }
 }
 
 CAnalyticsManager::~CAnalyticsManager()
 {
+    m_pSenderThread->quit();
+    m_pSenderThread->wait();
+
     if (m_pPlatformInfo)
     {
         m_pPlatformInfo->deleteLater();
@@ -74,12 +103,22 @@ CAnalyticsManager* CAnalyticsManager::current()
 {
     if (!m_pInstance)
     {
-        m_pInstance = new CAnalyticsManager(new CPlatformInfo());
+        m_pInstance = new CAnalyticsManager(m_platformInfoFactory());
     }
 
     return m_pInstance;
 }
 
+void CAnalyticsManager::setPlatformInfoFactory(TPlatformInfoFactory factory)
+{
+    m_platformInfoFactory = factory ? factory : &CAnalyticsManager::createPlatformInfo;
+}
+
+IPlatformInfo* CAnalyticsManager::createPlatformInfo()
+{
+    return new CPlatformInfo();
+}
+
 bool CAnalyticsManager::autoTrackNetworkConnectivity()
 {
     return m_autoTrackNetworkConnectivity;
@@ -113,18 +152,13 @@ CTracker* CAnalyticsManager::defaultTracker()
 
 bool CAnalyticsManager::appOptOut()
 {
-    if (!m_isAppOptOutSet)
-    {
-        loadAppOptOut();
-    }
-
-    return m_appOptOut;
+    return m_appOptOut.loadAcquire() != 0;
 }
 
 void CAnalyticsManager::setAppOptOut(bool &value)
 {
-    m_appOptOut = value;
-    m_isAppOptOutSet = true;
+    m_appOptOut.storeRelease(value ? 1 : 0);
+    applySettings();
 
     // Persist into registry
     QSettings settings;
@@ -138,13 +172,14 @@ CTracker* CAnalyticsManager::createTracker(QString propertyId)
     if (m_trackers.find(propertyId) == m_trackers.end())
     {
         CTracker* tracker = new CTracker(propertyId, m_pPlatformInfo, this);
-        tracker->AppName = QApplication::applicationName();
-        tracker->AppVersion = QApplication::applicationVersion();
+        tracker->AppName = QCoreApplication::applicationName();
+        tracker->AppVersion = QCoreApplication::applicationVersion();
 
         m_trackers.insert(propertyId, tracker);
         if (!m_pDefaultTracker)
         {
             m_pDefaultTracker = tracker;
+            m_pDefaultTracker->setCrashRecording(!m_crashFile.isEmpty());
         }
 
         return tracker;
@@ -160,139 +195,261 @@ void CAnalyticsManager::closeTracker(CTracker* pTracker)
     m_trackers.remove(pTracker->getPropertyId());
     if (m_pDefaultTracker == pTracker)
     {
+        m_pDefaultTracker->setCrashRecording(false);
         m_pDefaultTracker = Q_NULLPTR;
     }
 }
 
-IPlatformInfo* CAnalyticsManager::platformInfoProvider()
+QString CAnalyticsManager::journalFile() const
 {
-    return m_pPlatformInfo;
+    return m_journalFile;
 }
 
-void CAnalyticsManager::updateConnectionStatus()
+void CAnalyticsManager::setJournalFile(const QString &value)
 {
-    IsEnabled = m_pNetworkConfigurationManager->isOnline();
+    m_journalFile = value;
+    applySettings();
+
+    // Recovery has to be finished before new hits are accepted
+    QMetaObject::invokeMethod(m_pDispatcher, "setJournalFile", Qt::BlockingQueuedConnection, Q_ARG(QString, value));
 }
 
-void CAnalyticsManager::loadAppOptOut()
+QString CAnalyticsManager::crashFile() const
 {
-    QSettings settings;
-    settings.beginGroup("GoogleAnaltyics");
+    return m_crashFile;
+}
 
-    m_appOptOut = settings.value(m_keyAppOptOut, false).toBool();
-    m_isAppOptOutSet = true;
+void CAnalyticsManager::setCrashFile(const QString &value)
+{
+    m_crashFile = value;
 
-    settings.endGroup();
+    if (!value.isEmpty())
+    {
+        // Send the hit of a crashed run before the file is armed again
+        CHit hit;
+        if (CCrashRecorder::takeRecordedHit(value, hit))
+        {
+            enqueueHit(hit);
+        }
+
+        CCrashRecorder::install(value);
+    }
+    else
+    {
+        CCrashRecorder::uninstall();
+    }
+
+    if (m_pDefaultTracker)
+    {
+        m_pDefaultTracker->setCrashRecording(!value.isEmpty());
+    }
 }
 
-QString CAnalyticsManager::getCacheBuster()
+QString CAnalyticsManager::sharedQueueKey() const
 {
-    quint32 seed = QRandomGenerator::global()->generate();
-    QString seedString = QString::number(seed).leftJustified(9, '0', true);
-
-    return seedString;
+    return m_sharedQueueKey;
 }
 
-void CAnalyticsManager::onOnlineStateChanged(bool isOnline)
+void CAnalyticsManager::setSharedQueueKey(const QString &value)
 {
-    Q_UNUSED(isOnline)
-    updateConnectionStatus();
+    m_sharedQueueKey = value;
+    applySettings();
+
+    // The shared queue is attached before the next hit is sent
+    QMetaObject::invokeMethod(m_pDispatcher, "setSharedQueue", Qt::BlockingQueuedConnection, Q_ARG(QString, value));
 }
 
-void CAnalyticsManager::enqueueHit(const QMap<QString, QString> &params)
+void CAnalyticsManager::setTransport(ITransport* pTransport)
 {
-    if (!appOptOut())
-    {
-        CHit hit(params);
-        m_hitQueue.append(hit);
+    applySettings();
 
-        if (!m_isSending)
-        {
-            emit sendNextHit();
-        }
+    if (pTransport)
+    {
+        pTransport->moveToThread(m_pSenderThread);
     }
+
+    QMetaObject::invokeMethod(m_pDispatcher, "setTransport", Qt::BlockingQueuedConnection, Q_ARG(ITransport*, pTransport));
+}
+
+bool CAnalyticsManager::backpressure() const
+{
+    return m_pDispatcher->isBackpressure();
+}
+
+int CAnalyticsManager::adaptiveSampleFactor() const
+{
+    return m_pDispatcher->sampleFactor();
+}
+
+quint64 CAnalyticsManager::delayedHits() const
+{
+    return m_pDispatcher->delayedHits();
+}
+
+quint64 CAnalyticsManager::shedHits() const
+{
+    return m_pDispatcher->shedHits();
+}
+
+CAnalyticsManager::SSettings CAnalyticsManager::settings() const
+{
+    SSettings settings;
+    settings.IsSecure = IsSecure;
+    settings.IsDebug = IsDebug;
+    settings.PostData = PostData;
+    settings.BustCache = BustCache;
+    settings.BatchHits = BatchHits;
+    settings.MaxInFlight = MaxInFlight;
+    settings.MaxRetries = MaxRetries;
+    settings.RetryBaseDelay = RetryBaseDelay;
+    settings.RetryMaxDelay = RetryMaxDelay;
+    settings.MaxQueueSize = MaxQueueSize;
+    settings.MaxQueueBytes = MaxQueueBytes;
+    settings.OverflowPolicy = OverflowPolicy;
+    settings.MaxHitAge = MaxHitAge;
+    settings.AdaptiveQueueDepth = AdaptiveQueueDepth;
+    settings.AdaptiveSendLatency = AdaptiveSendLatency;
+    settings.RateLimitBurst = RateLimitBurst;
+    settings.RateLimitRefill = RateLimitRefill;
+    settings.RateLimitPolicy = RateLimitPolicy;
+    settings.PreConnect = PreConnect;
+    settings.AppOptOut = (m_appOptOut.loadAcquire() != 0);
+
+    return settings;
 }
 
-void CAnalyticsManager::onSendHit()
+void CAnalyticsManager::applySettings()
 {
-    if (m_hitQueue.isEmpty())
+    // The public fields are only written by the thread of the manager
+    if (QThread::currentThread() != thread())
     {
-        m_isSending = false;
         return;
     }
-    else
+
+    SSettings settings = this->settings();
+    if (settings == m_appliedSettings)
     {
-        m_isSending = true;
+        return;
     }
 
-    // Select correct endpoint
-    QString endPoint = IsDebug ? (IsSecure ? m_endPointSecureDebug : m_endPointUnsecureDebug) : (IsSecure ? m_endPointSecure : m_endPointUnsecure);
+    m_appliedSettings = settings;
+
+    CHitDispatcher* pDispatcher = m_pDispatcher;
+    QMetaObject::invokeMethod(m_pDispatcher, [pDispatcher, settings]() { pDispatcher->setSettings(settings); }, Qt::QueuedConnection);
+}
+
+bool CAnalyticsManager::SSettings::operator==(const SSettings &other) const
+{
+    return (IsSecure == other.IsSecure)
+        && (IsDebug == other.IsDebug)
+        && (PostData == other.PostData)
+        && (BustCache == other.BustCache)
+        && (BatchHits == other.BatchHits)
+        && (MaxInFlight == other.MaxInFlight)
+        && (MaxRetries == other.MaxRetries)
+        && (RetryBaseDelay == other.RetryBaseDelay)
+        && (RetryMaxDelay == other.RetryMaxDelay)
+        && (MaxQueueSize == other.MaxQueueSize)
+        && (MaxQueueBytes == other.MaxQueueBytes)
+        && (OverflowPolicy == other.OverflowPolicy)
+        && (MaxHitAge == other.MaxHitAge)
+        && (AdaptiveQueueDepth == other.AdaptiveQueueDepth)
+        && (AdaptiveSendLatency == other.AdaptiveSendLatency)
+        && (RateLimitBurst == other.RateLimitBurst)
+        && qFuzzyCompare(1.0 + RateLimitRefill, 1.0 + other.RateLimitRefill)
+        && (RateLimitPolicy == other.RateLimitPolicy)
+        && (PreConnect == other.PreConnect)
+        && (AppOptOut == other.AppOptOut);
+}
+
+bool CAnalyticsManager::SSettings::operator!=(const SSettings &other) const
+{
+    return !(*this == other);
+}
 
-    // Build query parameters
-    QUrlQuery query;
+CAnalyticsMetrics* CAnalyticsManager::metrics() const
+{
+    return m_pMetrics;
+}
 
-    // Get first element from queue
-    CHit hit = m_hitQueue.head();
-    QDateTime sendTime = QDateTime::currentDateTime();
-    qint64 timeDiff = hit.getTimeStamp().msecsTo(sendTime);
-    query.addQueryItem("qt", QString::number(timeDiff));
+bool CAnalyticsManager::flush(int timeoutMs)
+{
+    applySettings();
 
-    if (BustCache)
+    // Trackers are never destroyed at exit, the hits they still hold would be lost
+    for (QMap<QString, CTracker*>::const_iterator it = m_trackers.constBegin(), end = m_trackers.constEnd(); it != end; ++it)
     {
-        query.addQueryItem("z", getCacheBuster());
+        it.value()->flush();
     }
 
-    // Clone the data
-    QMap<QString, QString> data = hit.getData();
-    for(QMap<QString, QString>::const_iterator it = data.begin(), end = data.end(); it != end; ++it)
+    m_pDispatcher->beginFlush();
+    bool isFlushed = m_pDispatcher->waitForFlush(timeoutMs);
+    QMetaObject::invokeMethod(m_pDispatcher, "endFlush", Qt::QueuedConnection);
+
+    return isFlushed;
+}
+
+IPlatformInfo* CAnalyticsManager::platformInfoProvider()
+{
+    return m_pPlatformInfo;
+}
+
+void CAnalyticsManager::updateConnectionStatus()
+{
+    IsEnabled = m_pNetworkConfigurationManager->isOnline();
+}
+
+void CAnalyticsManager::loadAppOptOut()
+{
+    QSettings settings;
+    settings.beginGroup("GoogleAnaltyics");
+
+    m_appOptOut.storeRelease(settings.value(m_keyAppOptOut, false).toBool() ? 1 : 0);
+
+    settings.endGroup();
+}
+
+void CAnalyticsManager::onOnlineStateChanged(bool isOnline)
+{
+    updateConnectionStatus();
+    applySettings();
+
+    // Do not wait for the backoff when the network is back
+    if (isOnline)
     {
-        query.addQueryItem(it.key(), it.value());
+        QMetaObject::invokeMethod(m_pDispatcher, "warmUp", Qt::QueuedConnection);
+        QMetaObject::invokeMethod(m_pDispatcher, "resumeSending", Qt::QueuedConnection);
     }
+}
 
-    if (PostData)
+void CAnalyticsManager::onAboutToQuit()
+{
+    if (ShutdownFlushTimeout > 0)
     {
-        // Prepare network request for post
-        QNetworkRequest request(endPoint);
-        request.setHeader(QNetworkRequest::UserAgentHeader, m_pPlatformInfo->getUserAgent());
-        request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
+        flush(ShutdownFlushTimeout);
+    }
+}
 
-        QByteArray ba;
-        ba = query.query(QUrl::FullyEncoded).toUtf8();
-        request.setHeader(QNetworkRequest::ContentLengthHeader, ba.length());
+void CAnalyticsManager::enqueueHit(const QMap<QString, QString> &params)
+{
+    applySettings();
 
-        QNetworkReply* reply = m_pNetworkAccessManager->post(request, ba);
-        connect(reply, &QNetworkReply::finished, this, &CAnalyticsManager::onSendHitFinished);
-    }
-    else
+    if (!appOptOut())
     {
-        // Perform get request
-        QNetworkRequest request(endPoint + "?" + query.query(QUrl::FullyEncoded));
-        request.setHeader(QNetworkRequest::UserAgentHeader, m_pPlatformInfo->getUserAgent());
-
-        QNetworkReply* reply = m_pNetworkAccessManager->get(request);
-        connect(reply, &QNetworkReply::finished, this, &CAnalyticsManager::onSendHitFinished);
+        m_pDispatcher->enqueue(CHit(params));
     }
 }
 
-void CAnalyticsManager::onSendHitFinished()
+void CAnalyticsManager::enqueueHit(const CHit &hit)
 {
-    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
-    reply->deleteLater();
+    applySettings();
 
-    int httpStausCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-    if (httpStausCode < 200 || httpStausCode > 299)
+    if (!appOptOut())
     {
-        qDebug() << "[QtAnalytics]" << QString("Error sending message: %1").arg(reply->errorString());
-
-        // An error ocurred.
-        m_isSending = false;
-        return;
+        m_pDispatcher->enqueue(hit);
     }
     else
     {
-        qDebug() << "[QtAnalytics]" << "Message sent";
+        hit.complete(EHitDeliveryResult_Filtered);
     }
-
-    m_hitQueue.dequeue();
-    emit sendNextHit();
 }
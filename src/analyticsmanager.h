@@ -24,28 +24,97 @@
 #include "tracker.h"
 #include "ianalyticsmanager.h"
 #include "iplatforminfo.h"
+#include "analyticsmetrics.h"
 #include "hit.h"
+#include "itransport.h"
+#include "tokenbucket.h"
 
-#include <QQueue>
+#include <QAtomicInt>
 #include <QObject>
+#include <QThread>
 
-#include <QNetworkAccessManager>
 #include <QNetworkConfigurationManager>
 
 QTANALYTICS_NAMESPACE_BEGIN
 
+class CHitDispatcher;
+
 class CAnalyticsManager : public QObject, public IAnalyticsManager
 {
     Q_OBJECT
     Q_PROPERTY(bool autoTrackNetworkConnectivity READ autoTrackNetworkConnectivity WRITE setAutoTrackNetworkConnectivity)
     Q_PROPERTY(bool appOptOut READ appOptOut WRITE setAppOptOut)
+    Q_PROPERTY(CAnalyticsMetrics* metrics READ metrics CONSTANT)
+    Q_PROPERTY(int shutdownFlushTimeout MEMBER ShutdownFlushTimeout)
+    Q_PROPERTY(bool preConnect MEMBER PreConnect)
     Q_PROPERTY(bool isSecure MEMBER IsSecure)
     Q_PROPERTY(bool isDebug MEMBER IsDebug)
     Q_PROPERTY(bool isEnabled MEMBER IsEnabled)
     Q_PROPERTY(bool postData MEMBER PostData)
     Q_PROPERTY(bool bustCache MEMBER BustCache)
+    Q_PROPERTY(bool batchHits MEMBER BatchHits)
+    Q_PROPERTY(int maxInFlight MEMBER MaxInFlight)
+    Q_PROPERTY(QString journalFile READ journalFile WRITE setJournalFile)
+    Q_PROPERTY(QString crashFile READ crashFile WRITE setCrashFile)
+    Q_PROPERTY(QString sharedQueueKey READ sharedQueueKey WRITE setSharedQueueKey)
+    Q_PROPERTY(int maxRetries MEMBER MaxRetries)
+    Q_PROPERTY(int retryBaseDelay MEMBER RetryBaseDelay)
+    Q_PROPERTY(int retryMaxDelay MEMBER RetryMaxDelay)
+    Q_PROPERTY(int maxQueueSize MEMBER MaxQueueSize)
+    Q_PROPERTY(qint64 maxQueueBytes MEMBER MaxQueueBytes)
+    Q_PROPERTY(EOverflowPolicy overflowPolicy MEMBER OverflowPolicy)
+    Q_PROPERTY(int maxHitAge MEMBER MaxHitAge)
+    Q_PROPERTY(int adaptiveQueueDepth MEMBER AdaptiveQueueDepth)
+    Q_PROPERTY(int adaptiveSendLatency MEMBER AdaptiveSendLatency)
+    Q_PROPERTY(int rateLimitBurst MEMBER RateLimitBurst)
+    Q_PROPERTY(double rateLimitRefill MEMBER RateLimitRefill)
+    Q_PROPERTY(CTokenBucket::EPolicy rateLimitPolicy MEMBER RateLimitPolicy)
+    Q_PROPERTY(quint64 delayedHits READ delayedHits)
+    Q_PROPERTY(quint64 shedHits READ shedHits)
+    Q_PROPERTY(bool backpressure READ backpressure NOTIFY backpressureChanged)
 
 public:
+    ///
+    /// \brief Hits dropped when the queue is full.
+    ///
+    enum EOverflowPolicy
+    {
+        EOverflowPolicy_DropOldest,
+        EOverflowPolicy_DropNewest,
+        EOverflowPolicy_DropLowestPriority
+    };
+    Q_ENUM(EOverflowPolicy)
+
+    ///
+    /// \brief Copy of the settings the sender thread works with, see applySettings.
+    ///
+    struct SSettings
+    {
+        bool IsSecure;
+        bool IsDebug;
+        bool PostData;
+        bool BustCache;
+        bool BatchHits;
+        int MaxInFlight;
+        int MaxRetries;
+        int RetryBaseDelay;
+        int RetryMaxDelay;
+        int MaxQueueSize;
+        qint64 MaxQueueBytes;
+        EOverflowPolicy OverflowPolicy;
+        int MaxHitAge;
+        int AdaptiveQueueDepth;
+        int AdaptiveSendLatency;
+        int RateLimitBurst;
+        double RateLimitRefill;
+        CTokenBucket::EPolicy RateLimitPolicy;
+        bool PreConnect;
+        bool AppOptOut;
+
+        bool operator==(const SSettings &other) const;
+        bool operator!=(const SSettings &other) const;
+    };
+
     CAnalyticsManager(IPlatformInfo* pPlatformInfo, QObject* pParent = Q_NULLPTR);
     virtual ~CAnalyticsManager();
 
@@ -54,6 +123,14 @@ public:
     ///
     static CAnalyticsManager* current();
 
+    typedef IPlatformInfo* (*TPlatformInfoFactory)();
+
+    ///
+    /// \brief Sets the function which creates the platform information of the shared instance, Q_NULLPTR
+    ///        restores CPlatformInfo. Has no effect once current() was called.
+    ///
+    static void setPlatformInfoFactory(TPlatformInfoFactory factory);
+
     ///
     /// \brief Enables (when set to true) listening to network connectivity events
     ///        to have trackers behave accordingly to their connectivity status.
@@ -65,11 +142,26 @@ public:
 
     ///
     /// \brief True when the user has opted out of analytics, this disables
-    ///        all tracking activities.
+    ///        all tracking activities. May be read from any thread.
     ///
     bool appOptOut();
     void setAppOptOut(bool &value);
 
+    ///
+    /// \brief Gets the current values of the settings read by the sender thread.
+    ///
+    SSettings settings() const;
+
+    ///
+    /// \brief Hands changed settings over to the sender thread, does nothing when called from another
+    ///        thread than the one of the manager.
+    ///
+    ///        The sender thread never reads the public fields, it works with a copy. Changes are applied
+    ///        by the setters of the manager, by flush and when a hit is queued from the thread of the
+    ///        manager. Call this after changing fields when hits are only sent from other threads.
+    ///
+    void applySettings();
+
     ///
     /// \brief Gets the instance of PlatformInfo used by the Tracker instantiated by this manager.
     ///
@@ -85,6 +177,72 @@ public:
     ///
     void closeTracker(CTracker* pTracker);
 
+    ///
+    /// \brief Gets or sets the file used to journal queued hits, empty disables the journal.
+    ///        Hits left in the journal by a previous run are recovered and sent when it is set.
+    ///
+    QString journalFile() const;
+    void setJournalFile(const QString &value);
+
+    ///
+    /// \brief Gets or sets the file a fatal crash writes an exception hit of the default tracker to,
+    ///        empty disables crash recording. A hit left by a crashed run is sent when it is set.
+    ///        Stack overflows are only recorded for the thread which sets it, see CCrashRecorder.
+    ///
+    QString crashFile() const;
+    void setCrashFile(const QString &value);
+
+    ///
+    /// \brief Gets or sets the key of a shared memory queue used by all processes of the host which set
+    ///        the same key, empty sends hits from this process. Hits are written to the shared queue and
+    ///        a single elected process uploads them, another one takes over when it exits. Futures of
+    ///        hits handed to another process resolve as EHitDeliveryResult_Shared, their delivery is not
+    ///        tracked. Set it before hits are sent.
+    ///
+    QString sharedQueueKey() const;
+    void setSharedQueueKey(const QString &value);
+
+    ///
+    /// \brief Returns true while the queue is close to MaxQueueSize or MaxQueueBytes, callers
+    ///        should hold back hits which are not important.
+    ///
+    bool backpressure() const;
+
+    ///
+    /// \brief Replaces the transport hits are delivered with, null restores HTTP delivery.
+    ///
+    ///        The manager takes ownership of the transport, which must not have a parent. It
+    ///        is moved to the sender thread.
+    ///
+    void setTransport(ITransport* pTransport);
+
+    int adaptiveSampleFactor() const override;
+
+    ///
+    /// \brief Gets the number of hits which were sent late because of the rate limit of the manager.
+    ///
+    quint64 delayedHits() const;
+
+    ///
+    /// \brief Gets the number of hits which were discarded by the rate limit of the manager.
+    ///
+    quint64 shedHits() const;
+
+    ///
+    /// \brief Gets the counters and gauges of the dispatch pipeline, they may be read from any thread.
+    ///
+    CAnalyticsMetrics* metrics() const;
+
+    ///
+    /// \brief Sends queued hits for at most the given time and returns whether all of them were delivered.
+    ///
+    ///        The trackers first queue the hits they hold: timing summaries, merged events and hits
+    ///        waiting for their rate limit. Hits go out in the largest batches the transport supports.
+    ///        Hits which are left are kept in the journal if one is set. The call never blocks longer
+    ///        than the timeout.
+    ///
+    bool flush(int timeoutMs);
+
     ///
     /// \brief Gets or sets whether CHit should be sent via SSL. Default is true.
     ///
@@ -110,44 +268,136 @@ public:
     ///
     bool BustCache;
 
+    ///
+    /// \brief Gets or sets whether queued CHit should be combined into a single request to the
+    ///        batch endpoint. Only used when PostData is set. Default is false.
+    ///
+    bool BatchHits;
+
+    ///
+    /// \brief Gets or sets the number of requests which may be in flight at the same time.
+    ///        Default is 6, the number of connections QNetworkAccessManager opens per host.
+    ///
+    int MaxInFlight;
+
+    ///
+    /// \brief Gets or sets how often a hit is retried after transient errors before it is dropped. Default is 8.
+    ///
+    int MaxRetries;
+
+    ///
+    /// \brief Gets or sets the delay in milliseconds before the first retry, it doubles with every
+    ///        further failure. Default is 1000.
+    ///
+    int RetryBaseDelay;
+
+    ///
+    /// \brief Gets or sets the maximum delay in milliseconds between retries. Default is 300000.
+    ///
+    int RetryMaxDelay;
+
+    ///
+    /// \brief Gets or sets the maximum number of queued hits. Default is 10000.
+    ///
+    int MaxQueueSize;
+
+    ///
+    /// \brief Gets or sets the maximum payload bytes of all queued hits, 0 for no limit. Default is 8 MiB.
+    ///
+    qint64 MaxQueueBytes;
+
+    ///
+    /// \brief Gets or sets which hits are dropped when the queue is full. Default is EOverflowPolicy_DropOldest.
+    ///
+    EOverflowPolicy OverflowPolicy;
+
+    ///
+    /// \brief Gets or sets the age in milliseconds after which queued hits are dropped. Default is
+    ///        3 hours 55 minutes, just below the four hour queue time accepted by the protocol.
+    ///
+    int MaxHitAge;
+
+    ///
+    /// \brief Gets or sets the queue length above which trackers with adaptive sampling send fewer hits. Default is 1000.
+    ///
+    int AdaptiveQueueDepth;
+
+    ///
+    /// \brief Gets or sets the average send latency in milliseconds above which trackers with adaptive sampling
+    ///        send fewer hits. Default is 2000.
+    ///
+    int AdaptiveSendLatency;
+
+    ///
+    /// \brief Gets or sets the number of hits of all trackers which may be sent at once before the rate
+    ///        limit applies, once RateLimitRefill enables it. Default is 60, the quota of the mobile SDKs.
+    ///        Values below 1 are raised to 1.
+    ///
+    int RateLimitBurst;
+
+    ///
+    /// \brief Gets or sets the number of hits per second the rate limit allows after a burst, 0 for no limit.
+    ///        Default is 0, the mobile SDKs use 0.5 together with a burst of 60.
+    ///
+    double RateLimitRefill;
+
+    ///
+    /// \brief Gets or sets whether hits over the rate limit wait in the queue or are discarded. Default is EPolicy_Shape.
+    ///
+    CTokenBucket::EPolicy RateLimitPolicy;
+
+    ///
+    /// \brief Gets or sets the time in milliseconds hits are flushed when the application quits, 0 to not
+    ///        flush. Default is 2000.
+    ///
+    int ShutdownFlushTimeout;
+
+    ///
+    /// \brief Gets or sets whether the connection to the collector is opened when the manager is created
+    ///        and when the network comes back. Default is true.
+    ///
+    bool PreConnect;
+
+signals:
+    void backpressureChanged(bool isBackpressure);
+
 private:
     void updateConnectionStatus();
     void loadAppOptOut();
-    static QString getCacheBuster();
 
     bool m_autoTrackNetworkConnectivity;
     static QString m_keyAppOptOut;
-    bool m_isAppOptOutSet;
-    bool m_appOptOut;
+    QAtomicInt m_appOptOut;
 
     static CAnalyticsManager* m_pInstance;
+    static TPlatformInfoFactory m_platformInfoFactory;
+    static IPlatformInfo* createPlatformInfo();
     IPlatformInfo* m_pPlatformInfo;
 
     QNetworkConfigurationManager* m_pNetworkConfigurationManager;
-    QNetworkAccessManager* m_pNetworkAccessManager;
 
     QMap<QString, CTracker*> m_trackers;
     CTracker* m_pDefaultTracker;
 
-    static QString m_endPointUnsecureDebug;
-    static QString m_endPointSecureDebug;
-    static QString m_endPointUnsecure;
-    static QString m_endPointSecure;
-
-    QQueue<CHit> m_hitQueue;
-    bool m_isSending;
-
-signals:
-    void sendNextHit();
+    CAnalyticsMetrics* m_pMetrics;
+    QThread* m_pSenderThread;
+    CHitDispatcher* m_pDispatcher;
+    SSettings m_appliedSettings;
+    QString m_journalFile;
+    QString m_crashFile;
+    QString m_sharedQueueKey;
 
 private slots:
-    void onSendHit();
-    void onSendHitFinished();
     void onOnlineStateChanged(bool isOnline);
+    void onAboutToQuit();
 
     // IAnalyticsManager interface
 public:
+    ///
+    /// \brief Queues a hit for sending, may be called from any thread.
+    ///
     void enqueueHit(const QMap<QString, QString> &params);
+    void enqueueHit(const CHit &hit);
 };
 
 QTANALYTICS_NAMESPACE_END
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "analyticsmetrics.h"
+
+QTANALYTICS_NAMESPACE_USING
+
+CAnalyticsMetrics::CAnalyticsMetrics(QObject* pParent)
+    : QObject(pParent)
+    , m_hitsEnqueued(0)
+    , m_hitsSent(0)
+    , m_hitsDropped(0)
+    , m_hitsOverflowed(0)
+    , m_hitsShed(0)
+    , m_hitsRetried(0)
+    , m_queueDepth(0)
+    , m_queueBytes(0)
+    , m_inFlightRequests(0)
+    , m_requests(0)
+    , m_newConnections(0)
+{
+}
+
+CAnalyticsMetrics::~CAnalyticsMetrics()
+{
+}
+
+quint64 CAnalyticsMetrics::hitsEnqueued() const
+{
+    return m_hitsEnqueued.loadAcquire();
+}
+
+quint64 CAnalyticsMetrics::hitsSent() const
+{
+    return m_hitsSent.loadAcquire();
+}
+
+quint64 CAnalyticsMetrics::hitsDropped() const
+{
+    return m_hitsDropped.loadAcquire();
+}
+
+quint64 CAnalyticsMetrics::hitsOverflowed() const
+{
+    return m_hitsOverflowed.loadAcquire();
+}
+
+quint64 CAnalyticsMetrics::hitsShed() const
+{
+    return m_hitsShed.loadAcquire();
+}
+
+quint64 CAnalyticsMetrics::hitsRetried() const
+{
+    return m_hitsRetried.loadAcquire();
+}
+
+qint64 CAnalyticsMetrics::queueDepth() const
+{
+    return m_queueDepth.loadAcquire();
+}
+
+qint64 CAnalyticsMetrics::queueBytes() const
+{
+    return m_queueBytes.loadAcquire();
+}
+
+qint64 CAnalyticsMetrics::inFlightRequests() const
+{
+    return m_inFlightRequests.loadAcquire();
+}
+
+quint64 CAnalyticsMetrics::requests() const
+{
+    return m_requests.loadAcquire();
+}
+
+quint64 CAnalyticsMetrics::newConnections() const
+{
+    return m_newConnections.loadAcquire();
+}
+
+double CAnalyticsMetrics::connectionReuseRate() const
+{
+    quint64 requests = this->requests();
+    if (requests == 0)
+    {
+        return 1.0;
+    }
+
+    // Warm-ups open connections without a request, they count as reused by the first one
+    return 1.0 - (static_cast<double>(qMin(newConnections(), requests)) / requests);
+}
+
+SAnalyticsMetricsSnapshot CAnalyticsMetrics::snapshot() const
+{
+    SAnalyticsMetricsSnapshot snapshot;
+    snapshot.HitsEnqueued = hitsEnqueued();
+    snapshot.HitsSent = hitsSent();
+    snapshot.HitsDropped = hitsDropped();
+    snapshot.HitsOverflowed = hitsOverflowed();
+    snapshot.HitsShed = hitsShed();
+    snapshot.HitsRetried = hitsRetried();
+    snapshot.QueueDepth = queueDepth();
+    snapshot.QueueBytes = queueBytes();
+    snapshot.InFlightRequests = inFlightRequests();
+    snapshot.Requests = requests();
+    snapshot.NewConnections = newConnections();
+    snapshot.ConnectionReuseRate = connectionReuseRate();
+
+    m_sendLatency.copyInto(snapshot.SendLatencyBuckets);
+
+    snapshot.SendLatencyCount = 0;
+    for (int i = 0; i < snapshot.SendLatencyBuckets.size(); i++)
+    {
+        snapshot.SendLatencyCount += snapshot.SendLatencyBuckets.at(i);
+    }
+
+    snapshot.SendLatencyP50 = CTimingHistogram::percentile(snapshot.SendLatencyBuckets, snapshot.SendLatencyCount, 50.0);
+    snapshot.SendLatencyP90 = CTimingHistogram::percentile(snapshot.SendLatencyBuckets, snapshot.SendLatencyCount, 90.0);
+    snapshot.SendLatencyP99 = CTimingHistogram::percentile(snapshot.SendLatencyBuckets, snapshot.SendLatencyCount, 99.0);
+
+    return snapshot;
+}
+
+void CAnalyticsMetrics::addHitsEnqueued(int count)
+{
+    m_hitsEnqueued.fetchAndAddRelaxed(count);
+}
+
+void CAnalyticsMetrics::addHitsSent(int count)
+{
+    m_hitsSent.fetchAndAddRelaxed(count);
+}
+
+void CAnalyticsMetrics::addHitsDropped(int count)
+{
+    m_hitsDropped.fetchAndAddRelaxed(count);
+}
+
+void CAnalyticsMetrics::addHitsOverflowed(int count)
+{
+    m_hitsOverflowed.fetchAndAddRelaxed(count);
+}
+
+void CAnalyticsMetrics::addHitsShed(int count)
+{
+    m_hitsShed.fetchAndAddRelaxed(count);
+}
+
+void CAnalyticsMetrics::addHitsRetried(int count)
+{
+    m_hitsRetried.fetchAndAddRelaxed(count);
+}
+
+void CAnalyticsMetrics::addRequests(int count)
+{
+    m_requests.fetchAndAddRelaxed(count);
+}
+
+void CAnalyticsMetrics::addNewConnections(int count)
+{
+    m_newConnections.fetchAndAddRelaxed(count);
+}
+
+void CAnalyticsMetrics::setQueue(qint64 depth, qint64 bytes, qint64 inFlightRequests)
+{
+    m_queueDepth.storeRelease(depth);
+    m_queueBytes.storeRelease(bytes);
+    m_inFlightRequests.storeRelease(inFlightRequests);
+}
+
+void CAnalyticsMetrics::recordSendLatency(qint64 latency)
+{
+    m_sendLatency.record(static_cast<quint64>(qMax<qint64>(latency, 0)));
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "qtanalytics_global.h"
+#include "timinghistogram.h"
+
+#include <QAtomicInteger>
+#include <QObject>
+#include <QVector>
+
+QTANALYTICS_NAMESPACE_BEGIN
+
+///
+/// \brief Values of CAnalyticsMetrics at one point in time.
+///
+struct SAnalyticsMetricsSnapshot
+{
+    quint64 HitsEnqueued;
+    quint64 HitsSent;
+    quint64 HitsDropped;
+    quint64 HitsOverflowed;
+    quint64 HitsShed;
+    quint64 HitsRetried;
+    qint64 QueueDepth;
+    qint64 QueueBytes;
+    qint64 InFlightRequests;
+    quint64 Requests;
+    quint64 NewConnections;
+    double ConnectionReuseRate;
+
+    quint64 SendLatencyCount;
+    quint64 SendLatencyP50;
+    quint64 SendLatencyP90;
+    quint64 SendLatencyP99;
+
+    ///
+    /// \brief Request counts per latency bucket, see CTimingHistogram::bucketValue.
+    ///
+    QVector<quint64> SendLatencyBuckets;
+};
+
+///
+/// \brief Counters and gauges of the dispatch pipeline.
+///
+/// The sender thread updates the values with relaxed atomics, they may be read from any
+/// thread. Counters only grow, gauges show the current state and the latency histogram
+/// covers all requests in milliseconds.
+///
+class CAnalyticsMetrics : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(quint64 hitsEnqueued READ hitsEnqueued)
+    Q_PROPERTY(quint64 hitsSent READ hitsSent)
+    Q_PROPERTY(quint64 hitsDropped READ hitsDropped)
+    Q_PROPERTY(quint64 hitsOverflowed READ hitsOverflowed)
+    Q_PROPERTY(quint64 hitsShed READ hitsShed)
+    Q_PROPERTY(quint64 hitsRetried READ hitsRetried)
+    Q_PROPERTY(qint64 queueDepth READ queueDepth)
+    Q_PROPERTY(qint64 queueBytes READ queueBytes)
+    Q_PROPERTY(qint64 inFlightRequests READ inFlightRequests)
+    Q_PROPERTY(quint64 requests READ requests)
+    Q_PROPERTY(quint64 newConnections READ newConnections)
+    Q_PROPERTY(double connectionReuseRate READ connectionReuseRate)
+
+public:
+    CAnalyticsMetrics(QObject* pParent = Q_NULLPTR);
+    virtual ~CAnalyticsMetrics();
+
+    quint64 hitsEnqueued() const;
+    quint64 hitsSent() const;
+    quint64 hitsDropped() const;
+
+    ///
+    /// \brief Gets the number of hits dropped because the queue was full, they are part of hitsDropped.
+    ///
+    quint64 hitsOverflowed() const;
+
+    ///
+    /// \brief Gets the number of hits discarded by the rate limit, they are part of hitsDropped.
+    ///
+    quint64 hitsShed() const;
+
+    quint64 hitsRetried() const;
+    qint64 queueDepth() const;
+    qint64 queueBytes() const;
+    qint64 inFlightRequests() const;
+    quint64 requests() const;
+
+    ///
+    /// \brief Gets the number of connections opened to the collector, including the ones of warm-ups.
+    ///
+    quint64 newConnections() const;
+
+    ///
+    /// \brief Gets the share of requests which reused an open connection, 1 when none was sent yet.
+    ///
+    double connectionReuseRate() const;
+
+    ///
+    /// \brief Reads all values, including the percentiles of the send latency.
+    ///
+    SAnalyticsMetricsSnapshot snapshot() const;
+
+    void addHitsEnqueued(int count);
+    void addHitsSent(int count);
+    void addHitsDropped(int count);
+    void addHitsOverflowed(int count);
+    void addHitsShed(int count);
+    void addHitsRetried(int count);
+    void addRequests(int count);
+    void addNewConnections(int count);
+    void setQueue(qint64 depth, qint64 bytes, qint64 inFlightRequests);
+    void recordSendLatency(qint64 latency);
+
+private:
+    QAtomicInteger<quint64> m_hitsEnqueued;
+    QAtomicInteger<quint64> m_hitsSent;
+    QAtomicInteger<quint64> m_hitsDropped;
+    QAtomicInteger<quint64> m_hitsOverflowed;
+    QAtomicInteger<quint64> m_hitsShed;
+    QAtomicInteger<quint64> m_hitsRetried;
+    QAtomicInteger<qint64> m_queueDepth;
+    QAtomicInteger<qint64> m_queueBytes;
+    QAtomicInteger<qint64> m_inFlightRequests;
+    QAtomicInteger<quint64> m_requests;
+    QAtomicInteger<quint64> m_newConnections;
+
+    CTimingHistogram m_sendLatency;
+};
+
+QTANALYTICS_NAMESPACE_END
@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "crashrecorder.h"
+#include "analyticslogging.h"
+
+#include <QAtomicInt>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+
+#include <cerrno>
+#include <cstring>
+
+#if defined(Q_OS_UNIX)
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#endif
+
+QTANALYTICS_NAMESPACE_USING
+
+namespace
+{
+    // Everything the handler touches is allocated up front. The payload is double buffered,
+    // so a crash while the payload is replaced still finds a complete hit.
+    char s_payloads[2][CCrashRecorder::MaxPayloadSize];
+    QBasicAtomicInt s_payloadSizes[2] = { Q_BASIC_ATOMIC_INITIALIZER(0), Q_BASIC_ATOMIC_INITIALIZER(0) };
+    QAtomicInt s_activePayload(0);
+    QMutex s_payloadMutex;
+
+    bool s_isInstalled = false;
+
+    const char s_descriptionKey[] = "&exd=";
+
+    // Longer than every signal and exception name the handlers append to the description
+    const int s_maxNameSize = 32;
+
+#if defined(Q_OS_UNIX)
+    const int s_maxFileNameSize = 4096;
+    char s_fileName[s_maxFileNameSize];
+
+    // A crash on stack overflow has no stack left for the handler, only the installing thread gets this one
+    const int s_altStackSize = 64 * 1024;
+    char s_altStack[s_altStackSize];
+    stack_t s_previousAltStack;
+
+    struct SCrashSignal
+    {
+        int Number;
+        const char* Name;
+        int NameSize;
+    };
+
+    SCrashSignal s_signals[] =
+    {
+        { SIGSEGV, "SIGSEGV", 7 },
+        { SIGBUS,  "SIGBUS",  6 },
+        { SIGFPE,  "SIGFPE",  6 },
+        { SIGILL,  "SIGILL",  6 },
+        { SIGABRT, "SIGABRT", 7 }
+    };
+
+    const int s_signalCount = sizeof(s_signals) / sizeof(s_signals[0]);
+    struct sigaction s_previousActions[s_signalCount];
+
+    void writeAll(int fd, const char* pData, int size)
+    {
+        while (size > 0)
+        {
+            ssize_t written = ::write(fd, pData, static_cast<size_t>(size));
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                return;
+            }
+
+            pData += written;
+            size -= static_cast<int>(written);
+        }
+    }
+
+    // Only async-signal-safe calls from here on
+    void handleCrashSignal(int signalNumber, siginfo_t*, void*)
+    {
+        int index = 0;
+        while ((index < s_signalCount) && (s_signals[index].Number != signalNumber))
+        {
+            index++;
+        }
+
+        if (index == s_signalCount)
+        {
+            return;
+        }
+
+        int active = s_activePayload.loadAcquire();
+        int payloadSize = s_payloadSizes[active].loadAcquire();
+        if (payloadSize > 0)
+        {
+            int fd = ::open(s_fileName, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+            if (fd >= 0)
+            {
+                writeAll(fd, s_payloads[active], payloadSize);
+                writeAll(fd, s_descriptionKey, sizeof(s_descriptionKey) - 1);
+                writeAll(fd, s_signals[index].Name, s_signals[index].NameSize);
+                ::close(fd);
+            }
+        }
+
+        // The signal is blocked while it is handled, the previous handler gets it when this one returns
+        sigaction(signalNumber, &s_previousActions[index], Q_NULLPTR);
+        raise(signalNumber);
+    }
+#elif defined(Q_OS_WIN)
+    const int s_maxFileNameSize = 32768;
+    wchar_t s_fileName[s_maxFileNameSize];
+
+    const char s_exceptionName[] = "unhandled%20exception";
+    static_assert(sizeof(s_exceptionName) <= s_maxNameSize, "s_maxNameSize must cover the exception name");
+
+    LPTOP_LEVEL_EXCEPTION_FILTER s_pPreviousFilter = Q_NULLPTR;
+
+    LONG WINAPI handleUnhandledException(EXCEPTION_POINTERS* pExceptionInfo)
+    {
+        int active = s_activePayload.loadAcquire();
+        int payloadSize = s_payloadSizes[active].loadAcquire();
+        if (payloadSize > 0)
+        {
+            HANDLE file = CreateFileW(s_fileName, GENERIC_WRITE, 0, Q_NULLPTR, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, Q_NULLPTR);
+            if (file != INVALID_HANDLE_VALUE)
+            {
+                DWORD written = 0;
+                WriteFile(file, s_payloads[active], static_cast<DWORD>(payloadSize), &written, Q_NULLPTR);
+                WriteFile(file, s_descriptionKey, sizeof(s_descriptionKey) - 1, &written, Q_NULLPTR);
+                WriteFile(file, s_exceptionName, sizeof(s_exceptionName) - 1, &written, Q_NULLPTR);
+                CloseHandle(file);
+            }
+        }
+
+        return s_pPreviousFilter ? s_pPreviousFilter(pExceptionInfo) : EXCEPTION_CONTINUE_SEARCH;
+    }
+#endif
+}
+
+bool CCrashRecorder::install(const QString &fileName)
+{
+    uninstall();
+
+#if defined(Q_OS_UNIX)
+    QByteArray encodedFileName = QFile::encodeName(fileName);
+    if (encodedFileName.isEmpty() || (encodedFileName.size() >= s_maxFileNameSize))
+    {
+        qCWarning(lcQtAnalytics) << "Invalid crash file name" << fileName;
+        return false;
+    }
+
+    memcpy(s_fileName, encodedFileName.constData(), static_cast<size_t>(encodedFileName.size()) + 1);
+
+    stack_t altStack;
+    altStack.ss_sp = s_altStack;
+    altStack.ss_size = s_altStackSize;
+    altStack.ss_flags = 0;
+    sigaltstack(&altStack, &s_previousAltStack);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = handleCrashSignal;
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+
+    for (int i = 0; i < s_signalCount; i++)
+    {
+        sigaction(s_signals[i].Number, &action, &s_previousActions[i]);
+    }
+
+    s_isInstalled = true;
+#elif defined(Q_OS_WIN)
+    QString nativeFileName = QFileInfo(fileName).absoluteFilePath();
+    if (fileName.isEmpty() || (nativeFileName.size() >= s_maxFileNameSize))
+    {
+        qCWarning(lcQtAnalytics) << "Invalid crash file name" << fileName;
+        return false;
+    }
+
+    nativeFileName.toWCharArray(s_fileName);
+    s_fileName[nativeFileName.size()] = L'\0';
+
+    s_pPreviousFilter = SetUnhandledExceptionFilter(handleUnhandledException);
+    s_isInstalled = true;
+#else
+    Q_UNUSED(fileName)
+    qCWarning(lcQtAnalytics) << "Crash recording is not supported on this platform";
+#endif
+
+    return s_isInstalled;
+}
+
+void CCrashRecorder::uninstall()
+{
+    if (!s_isInstalled)
+    {
+        return;
+    }
+
+#if defined(Q_OS_UNIX)
+    for (int i = 0; i < s_signalCount; i++)
+    {
+        sigaction(s_signals[i].Number, &s_previousActions[i], Q_NULLPTR);
+    }
+
+    // Like install, this only affects the calling thread
+    sigaltstack(&s_previousAltStack, Q_NULLPTR);
+#elif defined(Q_OS_WIN)
+    SetUnhandledExceptionFilter(s_pPreviousFilter);
+    s_pPreviousFilter = Q_NULLPTR;
+#endif
+
+    s_isInstalled = false;
+}
+
+bool CCrashRecorder::isInstalled()
+{
+    return s_isInstalled;
+}
+
+void CCrashRecorder::setPayload(const QByteArray &payload)
+{
+    QMutexLocker locker(&s_payloadMutex);
+
+    // Fill the buffer the handler does not use, then switch over
+    int inactive = 1 - s_activePayload.loadAcquire();
+    if (payload.size() > MaxPayloadSize)
+    {
+        qCWarning(lcQtAnalytics) << "Crash hit too large, crash recording disarmed";
+        s_payloadSizes[inactive].storeRelease(0);
+    }
+    else
+    {
+        memcpy(s_payloads[inactive], payload.constData(), static_cast<size_t>(payload.size()));
+        s_payloadSizes[inactive].storeRelease(payload.size());
+    }
+
+    s_activePayload.storeRelease(inactive);
+}
+
+bool CCrashRecorder::takeRecordedHit(const QString &fileName, CHit &hit)
+{
+    QFile file(fileName);
+    if (!file.exists())
+    {
+        return false;
+    }
+
+    // The handler cannot format a time, the file knows when it was written
+    QDateTime timeStamp = QFileInfo(file).lastModified();
+    QByteArray payload;
+    if (file.open(QIODevice::ReadOnly))
+    {
+        // The handler appends the description key and the name of the signal to the payload
+        payload = file.read(MaxPayloadSize + static_cast<int>(sizeof(s_descriptionKey)) + s_maxNameSize);
+        file.close();
+    }
+
+    file.remove();
+    if (payload.isEmpty())
+    {
+        return false;
+    }
+
+    qCInfo(lcQtAnalytics) << "Recovered crash hit from" << fileName;
+    hit = CHit(payload, timeStamp);
+
+    return true;
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "qtanalytics_global.h"
+#include "hit.h"
+
+#include <QByteArray>
+#include <QString>
+
+QTANALYTICS_NAMESPACE_BEGIN
+
+///
+/// \brief Writes a fatal exception hit to a file when the process crashes.
+///
+/// The normal send path allocates and needs the event loop, neither is allowed in a signal
+/// handler. The recorder keeps the encoded hit in a preallocated buffer instead, the handler
+/// only appends the name of the signal and writes it with write(2). The hit is sent by the
+/// next run, its time is the modification time of the file.
+///
+/// On Unix the recorder handles SIGSEGV, SIGBUS, SIGFPE, SIGILL and SIGABRT, then passes the
+/// signal on to the previous handler. On Windows it installs an unhandled exception filter.
+///
+/// The alternate stack the handler runs on is a property of a thread, the recorder only sets one
+/// for the thread calling install. Crashes of other threads are recorded as well, except a stack
+/// overflow, which leaves the handler no stack to run on.
+///
+class CCrashRecorder
+{
+public:
+    ///
+    /// \brief Maximum size of the encoded hit, longer payloads disarm the recorder.
+    ///
+    static const int MaxPayloadSize = 8192;
+
+    ///
+    /// \brief Installs the crash handlers, a crash writes the hit to the given file. Call it from the
+    ///        thread whose stack overflows are to be recorded, usually the main thread.
+    ///
+    static bool install(const QString &fileName);
+
+    ///
+    /// \brief Restores the previous crash handlers and, for the calling thread, the previous alternate stack.
+    ///
+    static void uninstall();
+
+    static bool isInstalled();
+
+    ///
+    /// \brief Sets the encoded parameters of the crash hit, without description. Empty disarms the recorder.
+    ///
+    static void setPayload(const QByteArray &payload);
+
+    ///
+    /// \brief Takes the hit recorded by a previous run from the file and removes it.
+    ///
+    static bool takeRecordedHit(const QString &fileName, CHit &hit);
+
+private:
+    CCrashRecorder();
+};
+
+QTANALYTICS_NAMESPACE_END
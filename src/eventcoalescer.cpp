@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "eventcoalescer.h"
+
+#include <climits>
+
+QTANALYTICS_NAMESPACE_USING
+
+CEventCoalescer::CEventCoalescer(const TSink &sink, QObject* pParent)
+    : QObject(pParent)
+    , IsEnabled(false)
+    , Window(2000)
+    , CountMetric(0)
+    , m_sink(sink)
+    , m_pFlushTimer(new QTimer(this))
+    , m_isSchedulePending(0)
+{
+    m_pending.reserve(4096);
+
+    m_pFlushTimer->setSingleShot(true);
+    connect(m_pFlushTimer, &QTimer::timeout, this, &CEventCoalescer::onFlushExpired);
+}
+
+CEventCoalescer::~CEventCoalescer()
+{
+    // The sink may belong to an owner which is already being destroyed, the owner flushes before
+}
+
+bool CEventCoalescer::add(const CHitParameters &params, const QDateTime &timeStamp)
+{
+    if (!IsEnabled || (params.value(EHitParameter_HitType) != QLatin1String("event")))
+    {
+        return false;
+    }
+
+    // Everything but the value identifies the event
+    CHitParameters keyParams = params;
+    keyParams.remove(EHitParameter_EventValue);
+
+    QByteArray key;
+    keyParams.encode(key);
+
+    bool isValue = false;
+    long long value = params.value(EHitParameter_EventValue).toLongLong(&isValue);
+
+    QMutexLocker locker(&m_pendingMutex);
+    QHash<QByteArray, SPendingEvent>::iterator it = m_pending.find(key);
+    if (it != m_pending.end())
+    {
+        it->Value += isValue ? value : 0;
+        it->HasValue |= isValue;
+        it->Count++;
+        return true;
+    }
+
+    SPendingEvent pendingEvent;
+    pendingEvent.Params = keyParams;
+    pendingEvent.TimeStamp = timeStamp;
+    pendingEvent.Deadline = QDateTime::currentMSecsSinceEpoch() + qMax(Window, 0);
+    pendingEvent.Value = isValue ? value : 0;
+    pendingEvent.HasValue = isValue;
+    pendingEvent.Count = 1;
+
+    m_pending.insert(key, pendingEvent);
+    m_pendingOrder.enqueue(key);
+    bool isFirst = (m_pendingOrder.size() == 1);
+    locker.unlock();
+
+    if (isFirst)
+    {
+        scheduleFlush();
+    }
+
+    return true;
+}
+
+void CEventCoalescer::flush()
+{
+    flushPending(LLONG_MAX);
+}
+
+void CEventCoalescer::scheduleFlush()
+{
+    // Timers can only be started from the thread of the coalescer
+    if (m_isSchedulePending.testAndSetOrdered(0, 1))
+    {
+        QMetaObject::invokeMethod(this, "onFlushExpired", Qt::QueuedConnection);
+    }
+}
+
+void CEventCoalescer::onFlushExpired()
+{
+    m_isSchedulePending.storeRelease(0);
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    flushPending(now);
+
+    QMutexLocker locker(&m_pendingMutex);
+    if (!m_pendingOrder.isEmpty())
+    {
+        qint64 nextDeadline = m_pending.value(m_pendingOrder.head()).Deadline;
+        m_pFlushTimer->start(static_cast<int>(qBound<qint64>(0, nextDeadline - now, INT_MAX)));
+    }
+}
+
+void CEventCoalescer::flushPending(qint64 deadline)
+{
+    QList<SPendingEvent> expiredEvents;
+
+    QMutexLocker locker(&m_pendingMutex);
+    while (!m_pendingOrder.isEmpty())
+    {
+        QHash<QByteArray, SPendingEvent>::iterator it = m_pending.find(m_pendingOrder.head());
+        if (it->Deadline > deadline)
+        {
+            break;
+        }
+
+        expiredEvents.append(*it);
+        m_pending.erase(it);
+        m_pendingOrder.dequeue();
+    }
+    locker.unlock();
+
+    // The sink may block on the queue, so call it without holding the lock
+    for (QList<SPendingEvent>::iterator it = expiredEvents.begin(), end = expiredEvents.end(); it != end; ++it)
+    {
+        if (it->HasValue)
+        {
+            it->Params.insert(EHitParameter_EventValue, QString::number(it->Value));
+        }
+
+        if (CountMetric > 0)
+        {
+            it->Params.insert(EHitParameter_CustomMetric, CountMetric, QString::number(it->Count));
+        }
+
+        m_sink(it->Params, it->TimeStamp);
+    }
+}
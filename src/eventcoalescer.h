@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "qtanalytics_global.h"
+#include "hitparameters.h"
+
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QQueue>
+#include <QTimer>
+
+#include <functional>
+
+QTANALYTICS_NAMESPACE_BEGIN
+
+///
+/// \brief Merges identical events sent within a time window into one hit.
+///
+/// Events are identical when all their parameters except the value match. The first
+/// event of a key opens a window, further events only add their value and count. When
+/// the window has passed, one hit with the summed value and, when an index is set, the
+/// count as custom metric is handed to the sink with the time of the first event.
+///
+class CEventCoalescer : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool isEnabled MEMBER IsEnabled)
+    Q_PROPERTY(int window MEMBER Window)
+    Q_PROPERTY(int countMetric MEMBER CountMetric)
+
+public:
+    typedef std::function<void (const CHitParameters &params, const QDateTime &timeStamp)> TSink;
+
+    CEventCoalescer(const TSink &sink, QObject* pParent = Q_NULLPTR);
+    virtual ~CEventCoalescer();
+
+    ///
+    /// \brief Takes the hit when it is an event and coalescing is enabled, may be called from any thread.
+    ///
+    bool add(const CHitParameters &params, const QDateTime &timeStamp);
+
+    ///
+    /// \brief Gets or sets whether events are coalesced. Default is false.
+    ///
+    bool IsEnabled;
+
+    ///
+    /// \brief Gets or sets the time in milliseconds an event waits for identical ones. Default is 2000.
+    ///
+    int Window;
+
+    ///
+    /// \brief Gets or sets the custom metric index of the number of merged events, 0 to not send it.
+    ///
+    int CountMetric;
+
+public slots:
+    ///
+    /// \brief Hands all pending events to the sink, without waiting for their window.
+    ///
+    void flush();
+
+private slots:
+    void onFlushExpired();
+
+private:
+    struct SPendingEvent
+    {
+        CHitParameters Params;
+        QDateTime TimeStamp;
+        qint64 Deadline;
+        long long Value;
+        bool HasValue;
+        int Count;
+    };
+
+    void flushPending(qint64 deadline);
+    void scheduleFlush();
+
+    TSink m_sink;
+    QTimer* m_pFlushTimer;
+    QAtomicInt m_isSchedulePending;
+
+    // Windows have the same length, so keys expire in the order they were added
+    QMutex m_pendingMutex;
+    QHash<QByteArray, SPendingEvent> m_pending;
+    QQueue<QByteArray> m_pendingOrder;
+};
+
+QTANALYTICS_NAMESPACE_END
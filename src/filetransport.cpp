@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "filetransport.h"
+
+QTANALYTICS_NAMESPACE_USING
+
+CFileTransport::CFileTransport(const QString &fileName)
+    : ITransport()
+    , m_file(fileName)
+{
+}
+
+CFileTransport::~CFileTransport()
+{
+    m_file.close();
+}
+
+QString CFileTransport::fileName() const
+{
+    return m_file.fileName();
+}
+
+bool CFileTransport::supportsBatch() const
+{
+    return true;
+}
+
+void CFileTransport::send(quint64 requestId, const QList<QByteArray> &payloads)
+{
+    QVector<ETransportResult> results(payloads.size(), ETransportResult_Failed);
+    QString errorString;
+
+    if (!m_file.isOpen() && !m_file.open(QIODevice::WriteOnly | QIODevice::Append))
+    {
+        errorString = m_file.errorString();
+    }
+    else
+    {
+        for (int i = 0; i < payloads.size(); i++)
+        {
+            if ((m_file.write(payloads.at(i)) < 0) || !m_file.putChar('\n'))
+            {
+                errorString = m_file.errorString();
+                break;
+            }
+
+            results[i] = ETransportResult_Delivered;
+        }
+
+        m_file.flush();
+    }
+
+    // Results are reported after send has returned, like a network request would
+    QMetaObject::invokeMethod(this, [this, requestId, results, errorString]() { emit finished(requestId, results, errorString); }, Qt::QueuedConnection);
+}
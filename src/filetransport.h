@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "qtanalytics_global.h"
+#include "itransport.h"
+
+#include <QFile>
+
+QTANALYTICS_NAMESPACE_BEGIN
+
+///
+/// \brief Appends every hit as a line to a file instead of sending it, e.g. for offline capture.
+///
+class CFileTransport : public ITransport
+{
+    Q_OBJECT
+
+public:
+    CFileTransport(const QString &fileName);
+    virtual ~CFileTransport();
+
+    QString fileName() const;
+
+    bool supportsBatch() const override;
+    void send(quint64 requestId, const QList<QByteArray> &payloads) override;
+
+private:
+    QFile m_file;
+};
+
+QTANALYTICS_NAMESPACE_END
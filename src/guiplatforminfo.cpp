@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "guiplatforminfo.h"
+#include "analyticsmanager.h"
+
+#include <QApplication>
+#include <QResizeEvent>
+
+QTANALYTICS_NAMESPACE_USING
+
+namespace
+{
+    // Linking the add-on is enough for the shared manager to report the resolutions
+    void registerPlatformInfoFactory()
+    {
+        CAnalyticsManager::setPlatformInfoFactory(&CGuiPlatformInfo::create);
+    }
+}
+
+Q_COREAPP_STARTUP_FUNCTION(registerPlatformInfoFactory)
+
+CGuiPlatformInfo::CGuiPlatformInfo()
+    : CPlatformInfo()
+    , m_pActiveDesktop(Q_NULLPTR)
+    , m_pActiveWindow(Q_NULLPTR)
+    , m_windowInitialized(false)
+    , m_pResizeTimer(new QTimer(this))
+{
+    m_pResizeTimer->setSingleShot(true);
+    m_pResizeTimer->setInterval(250);
+    connect(m_pResizeTimer, &QTimer::timeout, this, &CGuiPlatformInfo::onResizeTimeout);
+
+    initializeWindow();
+    updateSnapshot();
+}
+
+IPlatformInfo* CGuiPlatformInfo::create()
+{
+    return new CGuiPlatformInfo();
+}
+
+CGuiPlatformInfo::~CGuiPlatformInfo()
+{
+    // Uninstall event filters
+    if (m_pActiveWindow)
+    {
+        m_pActiveWindow->removeEventFilter(this);
+    }
+
+    if (m_pActiveDesktop)
+    {
+        m_pActiveDesktop->removeEventFilter(this);
+    }
+
+    m_pActiveWindow = Q_NULLPTR;
+    m_pActiveDesktop = Q_NULLPTR;
+    m_windowInitialized = false;
+}
+
+int CGuiPlatformInfo::resizeDebounceInterval() const
+{
+    return m_pResizeTimer->interval();
+}
+
+void CGuiPlatformInfo::setResizeDebounceInterval(int value)
+{
+    m_pResizeTimer->setInterval(value);
+}
+
+void CGuiPlatformInfo::initializeWindow()
+{
+    QScreen* pActiveDesktop = qApp->primaryScreen();
+    if (pActiveDesktop)
+    {
+        // Setup resolutions
+        setScreenResolution(pActiveDesktop->geometry());
+
+        // Store for event processing
+        m_pActiveDesktop = pActiveDesktop;
+
+        // Install event filters
+        m_pActiveDesktop->installEventFilter(this);
+    }
+
+    QWidget* pActiveWindow = qApp->activeWindow();
+    if (pActiveWindow)
+    {
+        // Setup resolutions
+        setViewPortResolution(pActiveWindow->geometry());
+
+        // Store for event processing
+        m_pActiveWindow = pActiveWindow;
+
+        // Install event filters
+        m_pActiveWindow->installEventFilter(this);
+
+        m_windowInitialized = true;
+    }
+}
+
+void CGuiPlatformInfo::onResizeTimeout()
+{
+    bool isViewPortChanged = m_pendingViewPortResolution.isValid() && setViewPortResolution(m_pendingViewPortResolution);
+    bool isScreenChanged = m_pendingScreenResolution.isValid() && setScreenResolution(m_pendingScreenResolution);
+    m_pendingViewPortResolution = QRect();
+    m_pendingScreenResolution = QRect();
+
+    if (!isViewPortChanged && !isScreenChanged)
+    {
+        return;
+    }
+
+    updateSnapshot();
+
+    if (isViewPortChanged) emit viewPortResolutionChanged();
+    if (isScreenChanged) emit screenResolutionChanged();
+    emit snapshotChanged();
+}
+
+bool CGuiPlatformInfo::eventFilter(QObject* obj, QEvent* event)
+{
+    if (event->type() == QEvent::Resize)
+    {
+        // A window drag sends many resize events, only the last size counts
+        QResizeEvent* resizeEvent = static_cast<QResizeEvent*>(event);
+        if (obj == m_pActiveWindow)
+        {
+            m_pendingViewPortResolution = QRect(QPoint(0, 0), resizeEvent->size());
+            m_pResizeTimer->start();
+        }
+        else if (obj == m_pActiveDesktop)
+        {
+            m_pendingScreenResolution = QRect(QPoint(0, 0), resizeEvent->size());
+            m_pResizeTimer->start();
+        }
+
+        return false;
+    }
+
+    return CPlatformInfo::eventFilter(obj, event);
+}
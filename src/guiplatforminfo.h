@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "qtanalytics_global.h"
+#include "platforminfo.h"
+
+#include <QScreen>
+#include <QTimer>
+#include <QWidget>
+
+QTANALYTICS_NAMESPACE_BEGIN
+
+///
+/// \brief Platform information of the GUI add-on, tracks the resolutions of the primary screen and the active window.
+///
+class CGuiPlatformInfo: public CPlatformInfo
+{
+    Q_OBJECT
+    Q_PROPERTY(int resizeDebounceInterval READ resizeDebounceInterval WRITE setResizeDebounceInterval)
+
+public:
+    CGuiPlatformInfo();
+    virtual ~CGuiPlatformInfo();
+
+    ///
+    /// \brief Factory for CAnalyticsManager::setPlatformInfoFactory, the add-on registers it when the
+    ///        application starts.
+    ///
+    static IPlatformInfo* create();
+
+    ///
+    /// \brief Gets or sets the time in milliseconds resize events are collected before a change is raised. Default is 250.
+    ///
+    int resizeDebounceInterval() const;
+    void setResizeDebounceInterval(int value);
+
+protected:
+    bool eventFilter(QObject *obj, QEvent *event);
+
+private:
+    void initializeWindow();
+
+    QScreen *m_pActiveDesktop;
+    QWidget *m_pActiveWindow;
+    bool m_windowInitialized;
+
+    // Sizes of the last resize events, applied when the debounce timer fires
+    QTimer* m_pResizeTimer;
+    QRect m_pendingViewPortResolution;
+    QRect m_pendingScreenResolution;
+
+private slots:
+    void onResizeTimeout();
+};
+
+QTANALYTICS_NAMESPACE_END
@@ -21,34 +21,202 @@
 #pragma once
 
 #include "qtanalytics_global.h"
+#include "hitcompletion.h"
+#include "hitparameters.h"
 
-#include <QMap>
+#include <QByteArray>
 #include <QDateTime>
+#include <QMap>
 
 QTANALYTICS_NAMESPACE_BEGIN
 
+///
+/// \brief Dispatch lane of a hit, lower values are sent first.
+///
+enum EHitPriority
+{
+    EHitPriority_Critical,
+    EHitPriority_Normal,
+    EHitPriority_Bulk,
+    EHitPriority_Count,
+
+    EHitPriority_Default = EHitPriority_Count   ///< Derive the lane from the hit type
+};
+
 class CHit
 {
 public:
+    CHit()
+        : m_hitType(EHitTypeMask_None)
+        , m_priority(EHitPriority_Normal)
+        , m_journalId(0)
+        , m_retryCount(0)
+    {
+    }
+
     CHit(const QMap<QString, QString> &data)
-        : m_data(data)
+        : m_payload(encode(data))
         , m_timeStamp(QDateTime::currentDateTime())
+        , m_hitType(CHitSchema::hitTypeMask(data.value("t")))
+        , m_priority(defaultPriority(m_hitType))
+        , m_journalId(0)
+        , m_retryCount(0)
+    {
+    }
+
+    CHit(const QByteArray &payload, const QDateTime &timeStamp)
+        : m_payload(payload)
+        , m_timeStamp(timeStamp)
+        , m_hitType(parseHitType(payload))
+        , m_priority(defaultPriority(m_hitType))
+        , m_journalId(0)
+        , m_retryCount(0)
     {
     }
 
-    QMap<QString, QString> getData()
+    ///
+    /// \brief Gets the percent encoded UTF-8 parameters of this hit, without queue time.
+    ///
+    const QByteArray &getPayload() const
     {
-        return m_data;
+        return m_payload;
     }
 
-    QDateTime getTimeStamp()
+    QDateTime getTimeStamp() const
     {
         return m_timeStamp;
     }
 
+    ///
+    /// \brief Gets the type of this hit as EHitTypeMask.
+    ///
+    quint8 getHitType() const
+    {
+        return m_hitType;
+    }
+
+    ///
+    /// \brief Gets the dispatch lane of this hit.
+    ///
+    EHitPriority getPriority() const
+    {
+        return static_cast<EHitPriority>(m_priority);
+    }
+
+    ///
+    /// \brief Overrides the dispatch lane of this hit, EHitPriority_Default restores the lane of its hit type.
+    ///
+    void setPriority(EHitPriority priority)
+    {
+        m_priority = resolvePriority(m_hitType, priority);
+    }
+
+    ///
+    /// \brief Gets the id of the journal record holding this hit, 0 when not journaled.
+    ///
+    quint64 getJournalId() const
+    {
+        return m_journalId;
+    }
+
+    void setJournalId(quint64 journalId)
+    {
+        m_journalId = journalId;
+    }
+
+    ///
+    /// \brief Gets the number of failed attempts to send this hit.
+    ///
+    int getRetryCount() const
+    {
+        return m_retryCount;
+    }
+
+    void incrementRetryCount()
+    {
+        m_retryCount++;
+    }
+
+    ///
+    /// \brief Gets the completion of a hit sent with CTracker::sendAsync, null for all others.
+    ///
+    const THitCompletionPtr &getCompletion() const
+    {
+        return m_pCompletion;
+    }
+
+    void setCompletion(const THitCompletionPtr &pCompletion)
+    {
+        m_pCompletion = pCompletion;
+    }
+
+    ///
+    /// \brief Resolves the future of the hit, if it has one.
+    ///
+    void complete(EHitDeliveryResult result) const
+    {
+        if (m_pCompletion)
+        {
+            m_pCompletion->complete(result);
+        }
+    }
+
+    static QByteArray encode(const QMap<QString, QString> &data)
+    {
+        QByteArray payload;
+        CHitParameters::fromMap(data).encode(payload);
+
+        return payload;
+    }
+
+    ///
+    /// \brief Gets the dispatch lane of a hit type. Exceptions are sent ahead of the backlog, timings behind it.
+    ///
+    static EHitPriority defaultPriority(quint8 hitType)
+    {
+        switch (hitType)
+        {
+        case EHitTypeMask_Exception:
+            return EHitPriority_Critical;
+        case EHitTypeMask_Timing:
+            return EHitPriority_Bulk;
+        default:
+            return EHitPriority_Normal;
+        }
+    }
+
+    static EHitPriority resolvePriority(quint8 hitType, EHitPriority priority)
+    {
+        return (priority == EHitPriority_Default) ? defaultPriority(hitType) : priority;
+    }
+
+    static quint8 parseHitType(const QByteArray &payload)
+    {
+        // Find the 't' parameter in the encoded payload
+        int start = 2;
+        if (!payload.startsWith("t="))
+        {
+            start = payload.indexOf("&t=");
+            if (start < 0)
+            {
+                return EHitTypeMask_None;
+            }
+
+            start += 3;
+        }
+
+        int end = payload.indexOf('&', start);
+        return CHitSchema::hitTypeMask(QString::fromLatin1(payload.mid(start, (end < 0) ? -1 : end - start)));
+    }
+
 private:
-    QMap<QString, QString> m_data;
+    QByteArray m_payload;
     QDateTime m_timeStamp;
+    quint8 m_hitType;
+    quint8 m_priority;
+    quint64 m_journalId;
+    int m_retryCount;
+    THitCompletionPtr m_pCompletion;
 };
 
 QTANALYTICS_NAMESPACE_END
@@ -19,6 +19,10 @@
  */
 
 #include "hitbuilder.h"
+#include "analyticslogging.h"
+
+
+#include <utility>
 
 QTANALYTICS_NAMESPACE_USING
 
@@ -29,165 +33,168 @@ QString CHitBuilder::EHitType_UserTiming = QString("timing");
 
 CHitBuilder::CHitBuilder()
 {
-    m_lineage = QVector<CHitBuilder*>();
-    m_lineage.append(this);
-
-    m_data = QMap<QString, QString>();
 }
 
-CHitBuilder::CHitBuilder(QMap<QString, QString> &data)
+CHitBuilder::CHitBuilder(const QString &hitType)
 {
-    m_lineage = QVector<CHitBuilder*>();
-    m_lineage.append(this);
-
-    m_data = QMap<QString, QString>();
-    for(QMap<QString, QString>::const_iterator it = data.begin(), end = data.end(); it != end; ++it)
-    {
-        m_data.insert(it.key(), it.value());
-    }
+    m_data.insert(EHitParameter_HitType, hitType);
 }
 
-CHitBuilder::CHitBuilder(QVector<CHitBuilder*> &lineage, QMap<QString, QString> &data)
+CHitBuilder::CHitBuilder(CHitBuilder &&other) noexcept
+    : m_data(std::move(other.m_data))
 {
-    m_lineage = QVector<CHitBuilder*>();
-    for(QVector<CHitBuilder*>::const_iterator it = lineage.begin(), end = lineage.end(); it != end; ++it)
-    {
-        m_lineage.append(*it);
-    }
-    m_lineage.append(this);
+}
 
-    m_data = QMap<QString, QString>();
-    for(QMap<QString, QString>::const_iterator it = data.begin(), end = data.end(); it != end; ++it)
-    {
-        m_data.insert(it.key(), it.value());
-    }
+CHitBuilder &CHitBuilder::operator=(CHitBuilder &&other) noexcept
+{
+    m_data = std::move(other.m_data);
+    return *this;
 }
 
 CHitBuilder CHitBuilder::createScreenView()
 {
-    QMap<QString, QString> data;
-    data.insert("t", EHitType_Screenview);
-
-    return CHitBuilder(data);
+    return CHitBuilder(EHitType_Screenview);
 }
 
 CHitBuilder CHitBuilder::createScreenView(QString screenName)
 {
-    QMap<QString, QString> data;
-    data.insert("t", EHitType_Screenview);
+    CHitBuilder builder(EHitType_Screenview);
     if (!screenName.isEmpty())
     {
-        data.insert("cd", screenName);
+        builder.m_data.insert(EHitParameter_ScreenName, screenName);
     }
 
-    return CHitBuilder(data);
+    return builder;
 }
 
 CHitBuilder CHitBuilder::createCustomEvent(QString category, QString action, QString label, long long value)
 {
-    QMap<QString, QString> data;
-    data.insert("t", EHitType_Event);
-    data.insert("ec", category);
-    data.insert("ea", action);
+    CHitBuilder builder(EHitType_Event);
+    builder.m_data.insert(EHitParameter_EventCategory, category);
+    builder.m_data.insert(EHitParameter_EventAction, action);
 
-    if (!label.isEmpty()) data.insert("el", label);
-    if (value) data.insert("ev", QString("%1").arg(value));
+    if (!label.isEmpty()) builder.m_data.insert(EHitParameter_EventLabel, label);
+    if (value) builder.m_data.insert(EHitParameter_EventValue, QString::number(value));
 
-    return CHitBuilder(data);
+    return builder;
 }
 
 CHitBuilder CHitBuilder::createException(QString description, bool isFatal)
 {
-    QMap<QString, QString> data;
-    data.insert("t", EHitType_Exception);
+    CHitBuilder builder(EHitType_Exception);
 
-    if (!description.isEmpty()) data.insert("exd", description);
-    if (!isFatal) data.insert("exf", "0");
+    if (!description.isEmpty()) builder.m_data.insert(EHitParameter_ExceptionDescription, description);
+    if (!isFatal) builder.m_data.insert(EHitParameter_ExceptionFatal, "0");
 
-    return CHitBuilder(data);
+    return builder;
 }
 
 CHitBuilder CHitBuilder::createTiming(QString category, QString variable, quint64 time, QString label)
 {
-    QMap<QString, QString> data;
-    data.insert("t", EHitType_UserTiming);
+    CHitBuilder builder(EHitType_UserTiming);
 
-    if (!category.isEmpty()) data.insert("utc", category);
-    if (!variable.isEmpty()) data.insert("utv", variable);
-    if (time != 0) data.insert("utt", QString("%1").arg(time));
-    if (!label.isEmpty()) data.insert("utl", label);
+    if (!category.isEmpty()) builder.m_data.insert(EHitParameter_UserTimingCategory, category);
+    if (!variable.isEmpty()) builder.m_data.insert(EHitParameter_UserTimingVariable, variable);
+    if (time != 0) builder.m_data.insert(EHitParameter_UserTimingTime, QString::number(time));
+    if (!label.isEmpty()) builder.m_data.insert(EHitParameter_UserTimingLabel, label);
 
-    return CHitBuilder(data);
+    return builder;
 }
 
-QString CHitBuilder::getValue(QString paramName)
+QString CHitBuilder::getValue(const QString &paramName) const
 {
     return m_data.value(paramName);
 }
 
-CHitBuilder CHitBuilder::setValue(QString paramName, QString paramValue)
+CHitBuilder &CHitBuilder::setValue(const QString &paramName, const QString &paramValue) &
 {
-    if (m_data.contains(paramName))
+    m_data.insert(paramName, paramValue);
+    return *this;
+}
+
+CHitBuilder &&CHitBuilder::setValue(const QString &paramName, const QString &paramValue) &&
+{
+    return std::move(setValue(paramName, paramValue));
+}
+
+CHitBuilder &CHitBuilder::setAll(const QMap<QString, QString> &params) &
+{
+    for(QMap<QString, QString>::const_iterator it = params.begin(), end = params.end(); it != end; ++it)
     {
-        m_data.take(paramName);
+        m_data.insert(it.key(), it.value());
     }
-    m_data.insert(paramName, paramValue);
 
-    return CHitBuilder(m_lineage, m_data);
+    return *this;
 }
 
-CHitBuilder CHitBuilder::setAll(QMap<QString, QString>& params)
+CHitBuilder &&CHitBuilder::setAll(const QMap<QString, QString> &params) &&
 {
-    return CHitBuilder(m_lineage, params);
+    return std::move(setAll(params));
 }
 
-CHitBuilder CHitBuilder::setCustomDimension(int index, QString dimension)
+CHitBuilder &CHitBuilder::setCustomDimension(int index, const QString &dimension) &
 {
-    QMap<QString, QString> data;
-    data.insert(QString("cd%1").arg(index), dimension);
+    m_data.insert(EHitParameter_CustomDimension, index, dimension);
+    return *this;
+}
 
-    return CHitBuilder(m_lineage, data);
+CHitBuilder &&CHitBuilder::setCustomDimension(int index, const QString &dimension) &&
+{
+    return std::move(setCustomDimension(index, dimension));
 }
 
-CHitBuilder CHitBuilder::setCustomMetric(int index, long long metric)
+CHitBuilder &CHitBuilder::setCustomMetric(int index, long long metric) &
 {
-    QMap<QString, QString> data;
-    data.insert(QString("cd%1").arg(index), QString("%1").arg(metric));
+    m_data.insert(EHitParameter_CustomMetric, index, QString::number(metric));
+    return *this;
+}
 
-    return CHitBuilder(m_lineage, data);
+CHitBuilder &&CHitBuilder::setCustomMetric(int index, long long metric) &&
+{
+    return std::move(setCustomMetric(index, metric));
 }
 
-CHitBuilder CHitBuilder::setNewSession()
+CHitBuilder &CHitBuilder::setNewSession() &
 {
-    QMap<QString, QString> data;
-    data.insert("sc", "start");
+    m_data.insert(EHitParameter_SessionControl, "start");
+    return *this;
+}
 
-    return CHitBuilder(m_lineage, data);
+CHitBuilder &&CHitBuilder::setNewSession() &&
+{
+    return std::move(setNewSession());
 }
 
-CHitBuilder CHitBuilder::setNonInteraction()
+CHitBuilder &CHitBuilder::setNonInteraction() &
 {
-    QMap<QString, QString> data;
-    data.insert("ni", "1");
+    m_data.insert(EHitParameter_NonInteraction, "1");
+    return *this;
+}
 
-    return CHitBuilder(m_lineage, data);
+CHitBuilder &&CHitBuilder::setNonInteraction() &&
+{
+    return std::move(setNonInteraction());
+}
+
+CHitParameters CHitBuilder::build() const &
+{
+    validate();
+    return m_data;
 }
 
-QMap<QString, QString> CHitBuilder::build()
+CHitParameters CHitBuilder::build() &&
 {
-    QMap<QString, QString> data;
-    for(QVector<CHitBuilder*>::iterator lineageIt = m_lineage.begin(), end = m_lineage.end(); lineageIt != end; ++lineageIt)
+    validate();
+    return std::move(m_data);
+}
+
+void CHitBuilder::validate() const
+{
+#ifndef QT_NO_DEBUG
+    QStringList invalidKeys = m_data.invalidKeys();
+    if (!invalidKeys.isEmpty())
     {
-        CHitBuilder* pCurrent = *lineageIt;
-        for(QMap<QString, QString>::const_iterator it = pCurrent->m_data.begin(), end = pCurrent->m_data.end(); it != end; ++it)
-        {
-            if (data.contains(it.key()))
-            {
-                data.take(it.key());
-            }
-            data.insert(it.key(), it.value());
-        }
+        qCWarning(lcQtAnalytics) << QString("Parameters %1 do not apply to hit type '%2'").arg(invalidKeys.join(", ")).arg(m_data.value(EHitParameter_HitType));
     }
-
-    return data;
+#endif
 }
@@ -21,29 +21,35 @@
 #pragma once
 
 #include "hit.h"
+#include "hitparameters.h"
 #include "qtanalytics_global.h"
 
 #include <QMap>
-#include <QVector>
 
 QTANALYTICS_NAMESPACE_BEGIN
 
+///
+/// \brief Accumulates the parameters of a single hit.
+///
+/// The builder is move-only. Setters modify the builder in place and return it, so
+/// chained calls on a temporary neither copy nor allocate beyond the parameter values.
+///
 class CHitBuilder
 {
 private:
-    CHitBuilder(QMap<QString, QString>& data);
-    CHitBuilder(QVector<CHitBuilder*>& lineage, QMap<QString, QString>& data);
+    CHitBuilder(const QString &hitType);
 
     static QString EHitType_Screenview;
     static QString EHitType_Event;
     static QString EHitType_Exception;
     static QString EHitType_UserTiming;
 
-    QVector<CHitBuilder*> m_lineage;
-    QMap<QString, QString> m_data;
+    CHitParameters m_data;
 
 public:
     CHitBuilder();
+    CHitBuilder(CHitBuilder &&other) noexcept;
+    CHitBuilder &operator=(CHitBuilder &&other) noexcept;
 
     static CHitBuilder createScreenView();
     static CHitBuilder createScreenView(QString screenName);
@@ -54,17 +60,36 @@ public:
 
     static CHitBuilder createTiming(QString category, QString variable, quint64 time, QString label);
 
-    QString getValue(QString paramName);
-    CHitBuilder setValue(QString paramName, QString paramValue);
-    CHitBuilder setAll(QMap<QString, QString>& params);
+    QString getValue(const QString &paramName) const;
 
-    CHitBuilder setCustomDimension(int index, QString dimension);
-    CHitBuilder setCustomMetric(int index, long long metric);
+    CHitBuilder &setValue(const QString &paramName, const QString &paramValue) &;
+    CHitBuilder &&setValue(const QString &paramName, const QString &paramValue) &&;
 
-    CHitBuilder setNewSession();
-    CHitBuilder setNonInteraction();
+    CHitBuilder &setAll(const QMap<QString, QString> &params) &;
+    CHitBuilder &&setAll(const QMap<QString, QString> &params) &&;
 
-    QMap<QString, QString> build();
+    CHitBuilder &setCustomDimension(int index, const QString &dimension) &;
+    CHitBuilder &&setCustomDimension(int index, const QString &dimension) &&;
+
+    CHitBuilder &setCustomMetric(int index, long long metric) &;
+    CHitBuilder &&setCustomMetric(int index, long long metric) &&;
+
+    CHitBuilder &setNewSession() &;
+    CHitBuilder &&setNewSession() &&;
+
+    CHitBuilder &setNonInteraction() &;
+    CHitBuilder &&setNonInteraction() &&;
+
+    ///
+    /// \brief Returns the parameters of the hit, a temporary builder hands them over without copying.
+    ///
+    CHitParameters build() const &;
+    CHitParameters build() &&;
+
+private:
+    Q_DISABLE_COPY(CHitBuilder)
+
+    void validate() const;
 };
 
 QTANALYTICS_NAMESPACE_END
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "qtanalytics_global.h"
+
+#include <QAtomicInt>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QSharedPointer>
+
+QTANALYTICS_NAMESPACE_BEGIN
+
+///
+/// \brief Final state of a hit sent with CTracker::sendAsync.
+///
+enum EHitDeliveryResult
+{
+    EHitDeliveryResult_Delivered,   ///< The transport has delivered the hit
+    EHitDeliveryResult_Rejected,    ///< The hit is invalid and was dropped
+    EHitDeliveryResult_Dropped,     ///< The hit was dropped by a queue, age, rate or retry limit
+    EHitDeliveryResult_Filtered,    ///< The hit was not queued, because of sampling, rate limit or opt out
+    EHitDeliveryResult_Abandoned,   ///< The hit was not delivered before shutdown, it may be sent from the journal later
+    EHitDeliveryResult_Shared       ///< The hit was handed to the shared queue, the uploading process delivers it untracked
+};
+
+///
+/// \brief Resolves the future of a tracked hit exactly once.
+///
+/// Copies of a hit share the completion. When the last copy is gone before a result was
+/// reported, the future resolves as abandoned, so callers never wait forever.
+///
+class CHitCompletion
+{
+public:
+    CHitCompletion()
+        : m_isCompleted(0)
+    {
+        m_interface.reportStarted();
+    }
+
+    ~CHitCompletion()
+    {
+        complete(EHitDeliveryResult_Abandoned);
+    }
+
+    QFuture<EHitDeliveryResult> future()
+    {
+        return m_interface.future();
+    }
+
+    void complete(EHitDeliveryResult result)
+    {
+        if (m_isCompleted.testAndSetOrdered(0, 1))
+        {
+            m_interface.reportResult(result);
+            m_interface.reportFinished();
+        }
+    }
+
+    ///
+    /// \brief Returns a future which has already resolved with the given result.
+    ///
+    static QFuture<EHitDeliveryResult> completed(EHitDeliveryResult result)
+    {
+        CHitCompletion completion;
+        completion.complete(result);
+
+        return completion.future();
+    }
+
+private:
+    Q_DISABLE_COPY(CHitCompletion)
+
+    QFutureInterface<EHitDeliveryResult> m_interface;
+    QAtomicInt m_isCompleted;
+};
+
+typedef QSharedPointer<CHitCompletion> THitCompletionPtr;
+
+QTANALYTICS_NAMESPACE_END
@@ -0,0 +1,781 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "hitdispatcher.h"
+#include "analyticslogging.h"
+#include "analyticsmanager.h"
+#include "httptransport.h"
+
+#include <QRandomGenerator>
+
+#include <climits>
+
+QTANALYTICS_NAMESPACE_USING
+
+// Limits of the measurement protocol for batch requests
+const int CHitDispatcher::m_maxBatchHits = 20;
+const int CHitDispatcher::m_maxBatchBytes = 16 * 1024;
+const int CHitDispatcher::m_maxHitBytes = 8 * 1024;
+const int CHitDispatcher::m_maxSharedHits = 500;
+
+CHitDispatcher::CHitDispatcher(CAnalyticsManager* pAnalyticsManager, const CAnalyticsManager::SSettings &settings)
+    : QObject()
+    , m_pAnalyticsManager(pAnalyticsManager)
+    , m_settings(settings)
+    , m_pTransport(Q_NULLPTR)
+    , m_nextRequestId(1)
+    , m_isWakeUpPending(0)
+    , m_pJournal(new CHitJournal(this))
+    , m_isSharedRingProducer(0)
+    , m_pSharedQueueTimer(new QTimer(this))
+    , m_isSharedQueueLeader(false)
+    , m_pRetryTimer(new QTimer(this))
+    , m_retryLevel(0)
+    , m_pEvictionTimer(new QTimer(this))
+    , m_isBackpressure(0)
+    , m_rateLimiter(60, 0.0)
+    , m_pRateLimitTimer(new QTimer(this))
+    , m_isRateLimited(false)
+    , m_delayedHits(0)
+    , m_shedHits(0)
+    , m_sendLatency(0.0)
+    , m_sampleFactor(1000)
+    , m_isFlushing(false)
+    , m_isFlushed(true)
+{
+    m_clock.start();
+    setTransport(Q_NULLPTR);
+
+    m_pRetryTimer->setSingleShot(true);
+    connect(m_pRetryTimer, &QTimer::timeout, this, &CHitDispatcher::onSendHit);
+
+    m_pRateLimitTimer->setSingleShot(true);
+    connect(m_pRateLimitTimer, &QTimer::timeout, this, &CHitDispatcher::onSendHit);
+
+    m_pEvictionTimer->setInterval(60 * 1000);
+    connect(m_pEvictionTimer, &QTimer::timeout, this, &CHitDispatcher::onEvictExpiredHits);
+
+    // Renews the lease well within its timeout
+    m_pSharedQueueTimer->setInterval(200);
+    connect(m_pSharedQueueTimer, &QTimer::timeout, this, &CHitDispatcher::onSharedQueueTimer);
+}
+
+CHitDispatcher::~CHitDispatcher()
+{
+    // Detaching releases the lease, so another process takes over right away
+    m_isSharedRingProducer.storeRelease(0);
+    QWriteLocker locker(&m_sharedRingLock);
+    m_sharedRing.detach();
+}
+
+void CHitDispatcher::enqueue(const CHit &hit)
+{
+    m_pAnalyticsManager->metrics()->addHitsEnqueued(1);
+
+    // The leader sends its own hits right away, a full shared queue falls back to the queue of this process
+    if (m_isSharedRingProducer.loadAcquire())
+    {
+        QReadLocker locker(&m_sharedRingLock);
+        if (m_sharedRing.push(hit))
+        {
+            hit.complete(EHitDeliveryResult_Shared);
+            return;
+        }
+    }
+
+    m_inbox.push(hit);
+
+    // Wake up the sender thread, unless a wake up is already on its way
+    if (m_isWakeUpPending.testAndSetOrdered(0, 1))
+    {
+        QMetaObject::invokeMethod(this, "onSendHit", Qt::QueuedConnection);
+    }
+}
+
+void CHitDispatcher::setJournalFile(const QString &fileName)
+{
+    if (m_pJournal->isOpen() && (fileName == m_pJournal->fileName()))
+    {
+        return;
+    }
+
+    m_pJournal->close();
+    takeInbox();
+
+    // Hits in flight belong to the previous journal
+    for (QHash<quint64, SPendingRequest>::iterator it = m_pendingHits.begin(), end = m_pendingHits.end(); it != end; ++it)
+    {
+        for (QList<CHit>::iterator hitIt = it->Hits.begin(), hitEnd = it->Hits.end(); hitIt != hitEnd; ++hitIt)
+        {
+            hitIt->setJournalId(0);
+        }
+    }
+
+    if (fileName.isEmpty() || !m_pJournal->open(fileName))
+    {
+        m_hitQueue.forEach([](CHit &hit) { hit.setJournalId(0); });
+        return;
+    }
+
+    // Journal hits which are already queued
+    CHitJournal* pJournal = m_pJournal;
+    m_hitQueue.forEach([pJournal](CHit &hit) { hit.setJournalId(pJournal->append(hit)); });
+
+    // Recovered hits are older than everything else
+    requeueHits(m_pJournal->takeRecoveredHits());
+    if (!m_hitQueue.isEmpty() && !m_settings.AppOptOut)
+    {
+        onSendHit();
+    }
+}
+
+void CHitDispatcher::setSharedQueue(const QString &key)
+{
+    if (m_sharedRing.isAttached() && (key == m_sharedRing.key()))
+    {
+        return;
+    }
+
+    m_pSharedQueueTimer->stop();
+    m_isSharedQueueLeader = false;
+    m_isSharedRingProducer.storeRelease(0);
+
+    // The ring lives as long as the dispatcher, producers only ever see it attached or detached
+    {
+        QWriteLocker locker(&m_sharedRingLock);
+        m_sharedRing.detach();
+        if (key.isEmpty() || !m_sharedRing.attach(key))
+        {
+            return;
+        }
+    }
+
+    m_pSharedQueueTimer->start();
+    onSharedQueueTimer();
+}
+
+void CHitDispatcher::beginFlush()
+{
+    QMutexLocker locker(&m_flushMutex);
+    m_isFlushed = false;
+    locker.unlock();
+
+    QMetaObject::invokeMethod(this, "onBeginFlush", Qt::QueuedConnection);
+}
+
+bool CHitDispatcher::waitForFlush(int timeoutMs)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QMutexLocker locker(&m_flushMutex);
+    while (!m_isFlushed)
+    {
+        qint64 remaining = timeoutMs - timer.elapsed();
+        if ((remaining <= 0) || !m_flushCondition.wait(&m_flushMutex, static_cast<unsigned long>(remaining)))
+        {
+            break;
+        }
+    }
+
+    return m_isFlushed;
+}
+
+void CHitDispatcher::onBeginFlush()
+{
+    m_isFlushing = true;
+
+    // The uploader takes everything along, the next one would only get the lease after a timeout
+    if (m_isSharedQueueLeader)
+    {
+        drainSharedQueue(qMax(m_settings.MaxQueueSize - m_hitQueue.size(), 0));
+    }
+
+    // Do not wait for a backoff delay, there is no later
+    m_pRetryTimer->stop();
+    m_retryLevel = 0;
+
+    onSendHit();
+    checkFlushed();
+}
+
+void CHitDispatcher::endFlush()
+{
+    m_isFlushing = false;
+    takeInbox();
+
+    // Whatever is left has to survive in the journal
+    int remaining = m_hitQueue.size();
+    for (QHash<quint64, SPendingRequest>::const_iterator it = m_pendingHits.constBegin(), end = m_pendingHits.constEnd(); it != end; ++it)
+    {
+        remaining += it->Hits.size();
+    }
+
+    if (m_pJournal->isOpen())
+    {
+        m_pJournal->sync();
+    }
+
+    if (remaining > 0)
+    {
+        qCInfo(lcQtAnalytics) << QString("Flush incomplete, %1 messages %2").arg(remaining).arg(m_pJournal->isOpen() ? "kept in journal" : "not delivered");
+    }
+}
+
+void CHitDispatcher::warmUp()
+{
+    // Read when the call arrives, so the setting may still be changed right after the manager was created
+    if (m_settings.PreConnect && !m_settings.AppOptOut)
+    {
+        m_pTransport->warmUp();
+    }
+}
+
+void CHitDispatcher::checkFlushed()
+{
+    if (!m_isFlushing || !m_hitQueue.isEmpty() || !m_pendingHits.isEmpty() || !m_inbox.isEmpty())
+    {
+        return;
+    }
+
+    QMutexLocker locker(&m_flushMutex);
+    m_isFlushed = true;
+    m_flushCondition.wakeAll();
+}
+
+void CHitDispatcher::setSettings(const CAnalyticsManager::SSettings &settings)
+{
+    m_settings = settings;
+
+    CHttpTransport* pHttpTransport = qobject_cast<CHttpTransport*>(m_pTransport);
+    if (pHttpTransport)
+    {
+        pHttpTransport->setSettings(m_settings);
+    }
+
+    // Limits may have been raised
+    if (!m_hitQueue.isEmpty())
+    {
+        onSendHit();
+    }
+}
+
+void CHitDispatcher::setTransport(ITransport* pTransport)
+{
+    if (!pTransport)
+    {
+        pTransport = new CHttpTransport(m_pAnalyticsManager, m_settings);
+    }
+
+    // With requests in flight the previous transport stays a child, so their results still arrive
+    if (m_pTransport && m_pendingHits.isEmpty())
+    {
+        m_pTransport->deleteLater();
+    }
+
+    pTransport->setParent(this);
+    m_pTransport = pTransport;
+    connect(m_pTransport, &ITransport::finished, this, &CHitDispatcher::onSendHitFinished);
+}
+
+void CHitDispatcher::resumeSending()
+{
+    m_pRetryTimer->stop();
+    onSendHit();
+}
+
+bool CHitDispatcher::isBackpressure() const
+{
+    return m_isBackpressure.loadAcquire() != 0;
+}
+
+quint64 CHitDispatcher::delayedHits() const
+{
+    return m_delayedHits.loadAcquire();
+}
+
+quint64 CHitDispatcher::shedHits() const
+{
+    return m_shedHits.loadAcquire();
+}
+
+int CHitDispatcher::sampleFactor() const
+{
+    return m_sampleFactor.loadAcquire();
+}
+
+void CHitDispatcher::updateSampleFactor()
+{
+    // Keep the share of hits which brings queue length and latency back to their thresholds
+    double factor = 1.0;
+
+    int queueDepth = qMax(m_settings.AdaptiveQueueDepth, 1);
+    if (m_hitQueue.size() > queueDepth)
+    {
+        factor = qMin(factor, static_cast<double>(queueDepth) / m_hitQueue.size());
+    }
+
+    int sendLatency = qMax(m_settings.AdaptiveSendLatency, 1);
+    if (m_sendLatency > sendLatency)
+    {
+        factor = qMin(factor, sendLatency / m_sendLatency);
+    }
+
+    // Never go below one percent, some data is needed to notice the load has gone
+    m_sampleFactor.storeRelease(qBound(10, static_cast<int>(factor * 1000.0), 1000));
+}
+
+void CHitDispatcher::takeInbox()
+{
+    QList<CHit> droppedHits;
+    QList<CHit> shedHits;
+
+    m_rateLimiter.setRate(m_settings.RateLimitBurst, m_settings.RateLimitRefill);
+    bool isShedding = (m_settings.RateLimitPolicy == CTokenBucket::EPolicy_Shed);
+
+    CHit hit;
+    while (m_inbox.pop(hit))
+    {
+        // Shed hits over the limit before they are journaled, shaped ones wait in the queue.
+        // Critical hits are rare and must not be lost to a burst of other hits.
+        if (isShedding && !m_rateLimiter.tryTake() && (hit.getPriority() != EHitPriority_Critical))
+        {
+            shedHits.append(hit);
+            continue;
+        }
+
+        if (!makeRoomFor(hit, droppedHits))
+        {
+            droppedHits.append(hit);
+            continue;
+        }
+
+        if (m_pJournal->isOpen())
+        {
+            hit.setJournalId(m_pJournal->append(hit));
+        }
+
+        m_hitQueue.append(hit);
+    }
+
+    if (!droppedHits.isEmpty())
+    {
+        m_pAnalyticsManager->metrics()->addHitsOverflowed(droppedHits.size());
+        dropHits(droppedHits, "queue full");
+    }
+
+    if (!shedHits.isEmpty())
+    {
+        m_shedHits.fetchAndAddRelaxed(shedHits.size());
+        m_pAnalyticsManager->metrics()->addHitsShed(shedHits.size());
+        dropHits(shedHits, "rate limit exceeded");
+    }
+
+    if (!m_hitQueue.isEmpty() && !m_pEvictionTimer->isActive())
+    {
+        m_pEvictionTimer->start();
+    }
+
+    updateBackpressure();
+}
+
+bool CHitDispatcher::makeRoomFor(const CHit &hit, QList<CHit> &droppedHits)
+{
+    int maxSize = qMax(m_settings.MaxQueueSize, 1);
+    qint64 maxBytes = m_settings.MaxQueueBytes;
+
+    while (!m_hitQueue.isEmpty() && ((m_hitQueue.size() >= maxSize) || ((maxBytes > 0) && (m_hitQueue.bytes() + hit.getPayload().size() > maxBytes))))
+    {
+        switch (m_settings.OverflowPolicy)
+        {
+        case CAnalyticsManager::EOverflowPolicy_DropNewest:
+            return false;
+
+        case CAnalyticsManager::EOverflowPolicy_DropLowestPriority:
+            // Never drop a more important hit for a new one
+            if (CHitQueue::dropPriority(hit) <= m_hitQueue.lowestPriority())
+            {
+                return false;
+            }
+
+            droppedHits.append(m_hitQueue.takeLowestPriority());
+            break;
+
+        case CAnalyticsManager::EOverflowPolicy_DropOldest:
+        default:
+            droppedHits.append(m_hitQueue.takeOldest());
+            break;
+        }
+    }
+
+    return true;
+}
+
+void CHitDispatcher::updateBackpressure()
+{
+    m_pAnalyticsManager->metrics()->setQueue(m_hitQueue.size(), m_hitQueue.bytes(), m_pendingHits.size());
+
+    // Raise when 90% of a limit is used, clear below 70%
+    int maxSize = qMax(m_settings.MaxQueueSize, 1);
+    qint64 maxBytes = m_settings.MaxQueueBytes;
+
+    double fill = static_cast<double>(m_hitQueue.size()) / maxSize;
+    if (maxBytes > 0)
+    {
+        fill = qMax(fill, static_cast<double>(m_hitQueue.bytes()) / maxBytes);
+    }
+
+    bool isBackpressure = m_isBackpressure.loadAcquire() != 0;
+    if (!isBackpressure && (fill >= 0.9))
+    {
+        m_isBackpressure.storeRelease(1);
+        emit backpressureChanged(true);
+    }
+    else if (isBackpressure && (fill < 0.7))
+    {
+        m_isBackpressure.storeRelease(0);
+        emit backpressureChanged(false);
+    }
+}
+
+void CHitDispatcher::drainSharedQueue(int maxHits)
+{
+    // Only the sender thread attaches and detaches, it needs no lock to read the ring
+    if (!m_sharedRing.isAttached() || (maxHits <= 0))
+    {
+        return;
+    }
+
+    QList<CHit> hits;
+    while ((hits.size() < maxHits) && (m_sharedRing.pop(hits, maxHits - hits.size()) > 0))
+    {
+    }
+
+    if (hits.isEmpty())
+    {
+        return;
+    }
+
+    // Drained hits take the same path as local ones, including the journal
+    for (QList<CHit>::const_iterator it = hits.constBegin(), end = hits.constEnd(); it != end; ++it)
+    {
+        m_inbox.push(*it);
+    }
+
+    onSendHit();
+}
+
+void CHitDispatcher::onSharedQueueTimer()
+{
+    if (!m_sharedRing.isAttached())
+    {
+        return;
+    }
+
+    bool wasLeader = m_isSharedQueueLeader;
+    m_isSharedQueueLeader = m_sharedRing.renewLeadership() || m_sharedRing.tryAcquireLeadership();
+    m_isSharedRingProducer.storeRelease(m_isSharedQueueLeader ? 0 : 1);
+    if (m_isSharedQueueLeader != wasLeader)
+    {
+        qCInfo(lcQtAnalytics) << QString("%1 shared queue %2").arg(m_isSharedQueueLeader ? "Uploading hits of" : "Another process uploads hits of").arg(m_sharedRing.key());
+    }
+
+    // Hits stay in the shared queue while this process is behind, producers fall back to their own queue
+    if (m_isSharedQueueLeader && !isBackpressure())
+    {
+        drainSharedQueue(m_maxSharedHits);
+    }
+}
+
+void CHitDispatcher::onEvictExpiredHits()
+{
+    // The protocol drops hits with a queue time above four hours, do not send them at all
+    QDateTime limit = QDateTime::currentDateTime().addMSecs(-static_cast<qint64>(m_settings.MaxHitAge));
+    QList<CHit> expiredHits = m_hitQueue.takeExpired(limit);
+    if (!expiredHits.isEmpty())
+    {
+        dropHits(expiredHits, "queue time limit reached");
+        updateBackpressure();
+    }
+
+    if (m_hitQueue.isEmpty())
+    {
+        m_pEvictionTimer->stop();
+    }
+}
+
+QString CHitDispatcher::getCacheBuster()
+{
+    quint32 seed = QRandomGenerator::global()->generate();
+    QString seedString = QString::number(seed).leftJustified(9, '0', true);
+
+    return seedString;
+}
+
+QByteArray CHitDispatcher::encodeHit(const CHit &hit, const QDateTime &sendTime) const
+{
+    // Parameters are encoded when the hit is queued, only the queue time is added here
+    QByteArray ba;
+    ba.reserve(hit.getPayload().size() + 32);
+    ba.append(hit.getPayload());
+
+    // Queue time is relative to the hit, so every hit of a batch gets its own value
+    qint64 timeDiff = hit.getTimeStamp().msecsTo(sendTime);
+    ba.append("&qt=");
+    ba.append(QByteArray::number(timeDiff));
+
+    if (m_settings.BustCache)
+    {
+        ba.append("&z=");
+        ba.append(getCacheBuster().toLatin1());
+    }
+
+    return ba;
+}
+
+void CHitDispatcher::requeueHits(const QList<CHit> &hits)
+{
+    // Put hits back in front of the queue, keeping their original order
+    for (int i = hits.size() - 1; i >= 0; --i)
+    {
+        m_hitQueue.prepend(hits.at(i));
+    }
+}
+
+void CHitDispatcher::dropHits(const QList<CHit> &hits, const QString &reason, EHitDeliveryResult result)
+{
+    // Drops happen in bursts under overload, the metrics count them without formatting a message
+    qCDebug(lcQtAnalytics) << "Dropping" << hits.size() << "messages:" << reason;
+    m_pAnalyticsManager->metrics()->addHitsDropped(hits.size());
+
+    for (QList<CHit>::const_iterator it = hits.constBegin(), end = hits.constEnd(); it != end; ++it)
+    {
+        m_pJournal->acknowledge(*it);
+        it->complete(result);
+    }
+}
+
+void CHitDispatcher::retryHits(const QList<CHit> &hits)
+{
+    QList<CHit> retryHits;
+    QList<CHit> expiredHits;
+
+    // Every hit has its own retry budget
+    for (QList<CHit>::const_iterator it = hits.constBegin(), end = hits.constEnd(); it != end; ++it)
+    {
+        CHit hit = *it;
+        hit.incrementRetryCount();
+
+        if (hit.getRetryCount() > m_settings.MaxRetries)
+        {
+            expiredHits.append(hit);
+        }
+        else
+        {
+            retryHits.append(hit);
+        }
+    }
+
+    if (!expiredHits.isEmpty())
+    {
+        dropHits(expiredHits, "retry budget exhausted");
+    }
+
+    m_pAnalyticsManager->metrics()->addHitsRetried(retryHits.size());
+    requeueHits(retryHits);
+    scheduleRetry();
+}
+
+void CHitDispatcher::scheduleRetry()
+{
+    // Failures of concurrent requests share one delay, a flush has no later to wait for
+    if (m_isFlushing || m_pRetryTimer->isActive())
+    {
+        return;
+    }
+
+    // Exponential backoff, capped, with jitter in the upper half of the delay
+    qint64 maxDelay = qMax(m_settings.RetryMaxDelay, 1);
+    qint64 delay = qMin(static_cast<qint64>(qMax(m_settings.RetryBaseDelay, 1)) << qMin(m_retryLevel, 20), maxDelay);
+    delay = (delay / 2) + QRandomGenerator::global()->bounded(static_cast<int>(delay / 2) + 1);
+
+    m_retryLevel++;
+    m_pRetryTimer->start(static_cast<int>(delay));
+}
+
+void CHitDispatcher::onSendHit()
+{
+    m_isWakeUpPending.storeRelease(0);
+    takeInbox();
+
+    // Wait for the retry delay or the rate limit to pass
+    if (m_pRetryTimer->isActive() || (m_pRateLimitTimer->isActive() && !m_isFlushing))
+    {
+        return;
+    }
+
+    // Shed hits have been counted when they were taken, the queue holds only hits to shape.
+    // Hits not sent during a flush would be lost, so it does not wait for tokens.
+    bool isShaping = (m_settings.RateLimitPolicy == CTokenBucket::EPolicy_Shape) && !m_isFlushing;
+
+    // After errors a single request probes the endpoint, otherwise fill the window of concurrent requests
+    int maxInFlight = (m_retryLevel > 0) ? 1 : qMax(m_settings.MaxInFlight, 1);
+    while (!m_hitQueue.isEmpty() && (m_pendingHits.size() < maxInFlight))
+    {
+        int maxHits = isShaping ? m_rateLimiter.available() : INT_MAX;
+        if (maxHits <= 0)
+        {
+            m_isRateLimited = true;
+            m_pRateLimitTimer->start(qMax(m_rateLimiter.waitTime(), 1));
+            break;
+        }
+
+        sendHits(maxHits);
+    }
+
+    if (m_hitQueue.isEmpty())
+    {
+        m_isRateLimited = false;
+    }
+
+    updateBackpressure();
+    updateSampleFactor();
+}
+
+void CHitDispatcher::sendHits(int maxHits)
+{
+    QDateTime sendTime = QDateTime::currentDateTime();
+    SPendingRequest request;
+    QList<QByteArray> payloads;
+
+    // Take first element from queue
+    request.Hits.append(m_hitQueue.dequeue());
+    payloads.append(encodeHit(request.Hits.first(), sendTime));
+
+    // Oversized hits are sent alone, a flush uses the largest batches the transport supports
+    bool isBatch = (m_settings.BatchHits || m_isFlushing) && m_pTransport->supportsBatch() && (payloads.first().length() <= m_maxHitBytes);
+    if (isBatch)
+    {
+        int batchBytes = payloads.first().length();
+        while (!m_hitQueue.isEmpty() && (request.Hits.size() < qMin(m_maxBatchHits, maxHits)))
+        {
+            QByteArray line = encodeHit(m_hitQueue.head(), sendTime);
+            if ((line.length() > m_maxHitBytes) || (batchBytes + line.length() + 1 > m_maxBatchBytes))
+            {
+                break;
+            }
+
+            batchBytes += line.length() + 1;
+            payloads.append(line);
+            request.Hits.append(m_hitQueue.dequeue());
+        }
+    }
+
+    if (m_settings.RateLimitPolicy == CTokenBucket::EPolicy_Shape)
+    {
+        m_rateLimiter.tryTake(request.Hits.size());
+        if (m_isRateLimited)
+        {
+            m_delayedHits.fetchAndAddRelaxed(request.Hits.size());
+        }
+    }
+
+    // Remember hits until the transport has reported their results
+    quint64 requestId = m_nextRequestId++;
+    request.SendTime = m_clock.elapsed();
+    m_pendingHits.insert(requestId, request);
+
+    m_pTransport->send(requestId, payloads);
+}
+
+void CHitDispatcher::onSendHitFinished(quint64 requestId, const QVector<ETransportResult> &results, const QString &errorString)
+{
+    if (!m_pendingHits.contains(requestId))
+    {
+        return;
+    }
+
+    SPendingRequest request = m_pendingHits.take(requestId);
+    m_pAnalyticsManager->metrics()->setQueue(m_hitQueue.size(), m_hitQueue.bytes(), m_pendingHits.size());
+
+    // Exponential moving average of the request latency, used by adaptive sampling
+    qint64 latency = m_clock.elapsed() - request.SendTime;
+    m_sendLatency = (m_sendLatency * 0.8) + (latency * 0.2);
+
+    QList<CHit> deliveredHits;
+    QList<CHit> rejectedHits;
+    QList<CHit> failedHits;
+    for (int i = 0; i < request.Hits.size(); i++)
+    {
+        // Hits without a result did not go through
+        ETransportResult result = (i < results.size()) ? results.at(i) : ETransportResult_Failed;
+        switch (result)
+        {
+        case ETransportResult_Delivered:
+            deliveredHits.append(request.Hits.at(i));
+            break;
+
+        case ETransportResult_Rejected:
+            rejectedHits.append(request.Hits.at(i));
+            break;
+
+        case ETransportResult_Failed:
+        default:
+            failedHits.append(request.Hits.at(i));
+            break;
+        }
+    }
+
+    // Delivered hits are no longer needed in the journal
+    for (QList<CHit>::const_iterator it = deliveredHits.constBegin(), end = deliveredHits.constEnd(); it != end; ++it)
+    {
+        m_pJournal->acknowledge(*it);
+        it->complete(EHitDeliveryResult_Delivered);
+    }
+
+    m_pAnalyticsManager->metrics()->recordSendLatency(latency);
+    m_pAnalyticsManager->metrics()->addHitsSent(deliveredHits.size());
+    qCDebug(lcQtAnalytics) << QString("%1 messages sent").arg(deliveredHits.size());
+
+    if (!rejectedHits.isEmpty())
+    {
+        // Resending would fail the same way, drop them
+        dropHits(rejectedHits, errorString.isEmpty() ? QString("rejected") : errorString, EHitDeliveryResult_Rejected);
+    }
+
+    if (!failedHits.isEmpty())
+    {
+        qCDebug(lcQtAnalytics) << QString("Error sending message: %1").arg(errorString);
+        retryHits(failedHits);
+
+        // During a flush the retry budget of the hits bounds the attempts instead of the backoff
+        if (m_isFlushing)
+        {
+            onSendHit();
+        }
+
+        checkFlushed();
+        return;
+    }
+
+    m_retryLevel = 0;
+    onSendHit();
+    checkFlushed();
+}
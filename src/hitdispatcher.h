@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "qtanalytics_global.h"
+#include "analyticsmanager.h"
+#include "hit.h"
+#include "hitjournal.h"
+#include "hitqueue.h"
+#include "itransport.h"
+#include "mpscqueue.h"
+#include "sharedhitring.h"
+#include "tokenbucket.h"
+
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QQueue>
+#include <QReadWriteLock>
+#include <QTimer>
+#include <QWaitCondition>
+
+QTANALYTICS_NAMESPACE_BEGIN
+
+///
+/// \brief Sends queued hits on behalf of CAnalyticsManager.
+///
+/// The dispatcher lives in the sender thread owned by the manager. Hits are handed over
+/// through a lock-free queue, so enqueue may be called from any thread. Encoding and
+/// result handling happen in the sender thread, delivery is left to an ITransport which
+/// lives there as well. The dispatcher works with a copy of the settings of the manager,
+/// which the manager replaces through setSettings.
+///
+class CHitDispatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    CHitDispatcher(CAnalyticsManager* pAnalyticsManager, const CAnalyticsManager::SSettings &settings);
+    virtual ~CHitDispatcher();
+
+    ///
+    /// \brief Hands a hit over to the sender thread, or to the shared queue if one is set and another
+    ///        process uploads it. May be called from any thread.
+    ///
+    void enqueue(const CHit &hit);
+
+    ///
+    /// \brief Returns whether the queue is close to its limits, may be called from any thread.
+    ///
+    bool isBackpressure() const;
+
+    ///
+    /// \brief Gets the share of hits adaptive sampling keeps in per mille, may be called from any thread.
+    ///
+    int sampleFactor() const;
+
+    ///
+    /// \brief Starts sending all queued hits in the largest possible batches, may be called from any thread.
+    ///
+    void beginFlush();
+
+    ///
+    /// \brief Blocks until the queue has drained after beginFlush or the timeout has passed, returns
+    ///        whether all hits were delivered. May be called from any thread but the sender thread.
+    ///
+    bool waitForFlush(int timeoutMs);
+
+    ///
+    /// \brief Replaces the copy of the settings of the manager, must only be called from the sender thread.
+    ///
+    void setSettings(const CAnalyticsManager::SSettings &settings);
+
+    ///
+    /// \brief Gets the number of hits sent late because of the rate limit, may be called from any thread.
+    ///
+    quint64 delayedHits() const;
+
+    ///
+    /// \brief Gets the number of hits discarded by the rate limit, may be called from any thread.
+    ///
+    quint64 shedHits() const;
+
+signals:
+    ///
+    /// \brief Raised when the queue gets close to its limits and again when it has drained.
+    ///
+    void backpressureChanged(bool isBackpressure);
+
+public slots:
+    ///
+    /// \brief Switches the journal to the given file, empty disables the journal.
+    ///
+    void setJournalFile(const QString &fileName);
+
+    ///
+    /// \brief Attaches to the shared queue with the given key, empty detaches. Hits are written to the
+    ///        shared queue and sent by whichever attached process holds the lease, that process queues its
+    ///        own hits locally.
+    ///
+    void setSharedQueue(const QString &key);
+
+    ///
+    /// \brief Cancels a pending retry delay and sends queued hits right away.
+    ///
+    void resumeSending();
+
+    ///
+    /// \brief Replaces the transport hits are delivered with and takes ownership of it, null restores HTTP.
+    ///
+    ///        Requests in flight are completed by the previous transport.
+    ///
+    void setTransport(ITransport* pTransport);
+
+    ///
+    /// \brief Leaves the flush mode, commits the journal and reports the hits which were not delivered.
+    ///
+    void endFlush();
+
+    ///
+    /// \brief Lets the transport prepare its connection, unless PreConnect is disabled.
+    ///
+    void warmUp();
+
+private:
+    void takeInbox();
+    bool makeRoomFor(const CHit &hit, QList<CHit> &droppedHits);
+    void updateBackpressure();
+    void updateSampleFactor();
+    void sendHits(int maxHits);
+    QByteArray encodeHit(const CHit &hit, const QDateTime &sendTime) const;
+    void requeueHits(const QList<CHit> &hits);
+    void dropHits(const QList<CHit> &hits, const QString &reason, EHitDeliveryResult result = EHitDeliveryResult_Dropped);
+    void retryHits(const QList<CHit> &hits);
+    void scheduleRetry();
+    void checkFlushed();
+    void drainSharedQueue(int maxHits);
+
+    static QString getCacheBuster();
+
+    static const int m_maxBatchHits;
+    static const int m_maxBatchBytes;
+    static const int m_maxHitBytes;
+    static const int m_maxSharedHits;
+
+    CAnalyticsManager* m_pAnalyticsManager;
+    CAnalyticsManager::SSettings m_settings;
+    ITransport* m_pTransport;
+    quint64 m_nextRequestId;
+
+    CMpscQueue<CHit> m_inbox;
+    QAtomicInt m_isWakeUpPending;
+
+    CHitQueue m_hitQueue;
+    struct SPendingRequest
+    {
+        QList<CHit> Hits;
+        qint64 SendTime;
+    };
+
+    QHash<quint64, SPendingRequest> m_pendingHits;
+    CHitJournal* m_pJournal;
+
+    // Producers push from any thread, the sender thread attaches and detaches under the write lock.
+    // The flag is set while another process uploads, so hits without a shared queue take no lock.
+    CSharedHitRing m_sharedRing;
+    QReadWriteLock m_sharedRingLock;
+    QAtomicInt m_isSharedRingProducer;
+    QTimer* m_pSharedQueueTimer;
+    bool m_isSharedQueueLeader;
+
+    QTimer* m_pRetryTimer;
+    int m_retryLevel;
+
+    QTimer* m_pEvictionTimer;
+    QAtomicInt m_isBackpressure;
+
+    CTokenBucket m_rateLimiter;
+    QTimer* m_pRateLimitTimer;
+    bool m_isRateLimited;
+    QAtomicInteger<quint64> m_delayedHits;
+    QAtomicInteger<quint64> m_shedHits;
+
+    QElapsedTimer m_clock;
+    double m_sendLatency;
+    QAtomicInt m_sampleFactor;
+
+    // Flush state, the flag is only used in the sender thread, the rest is shared with the waiting thread
+    bool m_isFlushing;
+    QMutex m_flushMutex;
+    QWaitCondition m_flushCondition;
+    bool m_isFlushed;
+
+private slots:
+    void onSendHit();
+    void onSendHitFinished(quint64 requestId, const QVector<ETransportResult> &results, const QString &errorString);
+    void onEvictExpiredHits();
+    void onBeginFlush();
+    void onSharedQueueTimer();
+};
+
+QTANALYTICS_NAMESPACE_END
@@ -0,0 +1,457 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "hitjournal.h"
+#include "analyticslogging.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <cstddef>
+#include <cstring>
+
+#if defined(Q_OS_UNIX)
+#include <sys/mman.h>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#endif
+
+QTANALYTICS_NAMESPACE_USING
+
+const quint32 CHitJournal::m_fileMagic = 0x4a415451;      // 'QTAJ'
+const quint32 CHitJournal::m_fileVersion = 1;
+const quint32 CHitJournal::m_recordMagic = 0x52484151;    // 'QAHR'
+const qint64 CHitJournal::m_headerSize = 8;
+const qint64 CHitJournal::m_initialSize = 64 * 1024;
+const qint64 CHitJournal::m_compactThreshold = 256 * 1024;
+
+CHitJournal::CHitJournal(QObject* pParent)
+    : QObject(pParent)
+    , m_pData(Q_NULLPTR)
+    , m_mappedSize(0)
+    , m_writeOffset(0)
+    , m_deadBytes(0)
+    , m_nextId(1)
+    , m_pCommitTimer(new QTimer(this))
+    , m_isDirty(false)
+{
+    m_pCommitTimer->setSingleShot(true);
+    m_pCommitTimer->setInterval(1000);
+
+    connect(m_pCommitTimer, &QTimer::timeout, this, &CHitJournal::onCommitTimeout);
+}
+
+CHitJournal::~CHitJournal()
+{
+    close();
+}
+
+bool CHitJournal::open(const QString &fileName)
+{
+    close();
+
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadWrite))
+    {
+        qCWarning(lcQtAnalytics) << QString("Error opening journal: %1").arg(m_file.errorString());
+        return false;
+    }
+
+    // New files are preallocated, appends only copy into the mapping
+    qint64 size = m_file.size();
+    if (size < m_initialSize)
+    {
+        size = m_initialSize;
+        m_file.resize(size);
+    }
+
+    if (!map(size))
+    {
+        qCWarning(lcQtAnalytics) << QString("Error mapping journal: %1").arg(m_file.errorString());
+        m_file.close();
+        return false;
+    }
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    memcpy(&magic, m_pData, sizeof(magic));
+    memcpy(&version, m_pData + sizeof(magic), sizeof(version));
+    if ((magic != m_fileMagic) || (version != m_fileVersion))
+    {
+        // Unknown or empty file, start a new journal
+        memset(m_pData, 0, static_cast<size_t>(m_mappedSize));
+        memcpy(m_pData, &m_fileMagic, sizeof(m_fileMagic));
+        memcpy(m_pData + sizeof(m_fileMagic), &m_fileVersion, sizeof(m_fileVersion));
+        m_writeOffset = m_headerSize;
+    }
+    else
+    {
+        recover();
+    }
+
+    return true;
+}
+
+void CHitJournal::close()
+{
+    if (m_pData)
+    {
+        sync();
+        unmap();
+    }
+
+    if (m_file.isOpen())
+    {
+        m_file.close();
+    }
+
+    m_pCommitTimer->stop();
+    m_pendingRecords.clear();
+    m_recoveredHits.clear();
+    m_writeOffset = 0;
+    m_deadBytes = 0;
+}
+
+bool CHitJournal::isOpen() const
+{
+    return m_pData != Q_NULLPTR;
+}
+
+QString CHitJournal::fileName() const
+{
+    return m_file.fileName();
+}
+
+int CHitJournal::commitInterval() const
+{
+    return m_pCommitTimer->interval();
+}
+
+void CHitJournal::setCommitInterval(int value)
+{
+    m_pCommitTimer->setInterval(value);
+}
+
+QList<CHit> CHitJournal::takeRecoveredHits()
+{
+    QList<CHit> hits;
+    hits.swap(m_recoveredHits);
+
+    return hits;
+}
+
+quint64 CHitJournal::append(const CHit &hit)
+{
+    if (!m_pData)
+    {
+        return 0;
+    }
+
+    const QByteArray &payload = hit.getPayload();
+
+    SRecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.Magic = m_recordMagic;
+    header.Length = static_cast<quint32>(payload.size());
+    header.Id = m_nextId;
+    header.TimeStamp = hit.getTimeStamp().toMSecsSinceEpoch();
+    header.State = ERecordState_Pending;
+    header.Checksum = checksum(header, payload.constData());
+
+    qint64 recordSize = alignedSize(static_cast<qint64>(sizeof(SRecordHeader)) + payload.size());
+    if (!reserve(recordSize))
+    {
+        return 0;
+    }
+
+    // Payload first, header last, so a torn record never passes the checksum
+    memcpy(m_pData + m_writeOffset + sizeof(SRecordHeader), payload.constData(), static_cast<size_t>(payload.size()));
+    memcpy(m_pData + m_writeOffset, &header, sizeof(SRecordHeader));
+
+    m_pendingRecords.insert(header.Id, m_writeOffset);
+    m_writeOffset += recordSize;
+    m_nextId++;
+
+    m_isDirty = true;
+    if (!m_pCommitTimer->isActive())
+    {
+        m_pCommitTimer->start();
+    }
+
+    return header.Id;
+}
+
+void CHitJournal::acknowledge(const CHit &hit)
+{
+    QHash<quint64, qint64>::iterator it = m_pendingRecords.find(hit.getJournalId());
+    if (!m_pData || (it == m_pendingRecords.end()))
+    {
+        return;
+    }
+
+    qint64 offset = it.value();
+    m_pendingRecords.erase(it);
+
+    SRecordHeader header;
+    memcpy(&header, m_pData + offset, sizeof(SRecordHeader));
+    m_pData[offset + offsetof(SRecordHeader, State)] = ERecordState_Acknowledged;
+    m_deadBytes += alignedSize(static_cast<qint64>(sizeof(SRecordHeader)) + header.Length);
+
+    m_isDirty = true;
+    if (!m_pCommitTimer->isActive())
+    {
+        m_pCommitTimer->start();
+    }
+
+    if (m_pendingRecords.isEmpty())
+    {
+        // Everything is acknowledged, simply start over at the beginning
+        memset(m_pData + m_headerSize, 0, sizeof(SRecordHeader));
+        m_writeOffset = m_headerSize;
+        m_deadBytes = 0;
+    }
+    else if ((m_deadBytes > m_compactThreshold) && (m_deadBytes * 2 > m_writeOffset))
+    {
+        compact();
+    }
+}
+
+void CHitJournal::sync()
+{
+    if (!m_pData || !m_isDirty)
+    {
+        return;
+    }
+
+#if defined(Q_OS_UNIX)
+    msync(m_pData, static_cast<size_t>(m_writeOffset), MS_SYNC);
+#elif defined(Q_OS_WIN)
+    FlushViewOfFile(m_pData, static_cast<SIZE_T>(m_writeOffset));
+#endif
+
+    m_isDirty = false;
+}
+
+void CHitJournal::onCommitTimeout()
+{
+    sync();
+}
+
+bool CHitJournal::map(qint64 size)
+{
+    m_pData = m_file.map(0, size);
+    m_mappedSize = m_pData ? size : 0;
+
+    return m_pData != Q_NULLPTR;
+}
+
+void CHitJournal::unmap()
+{
+    if (m_pData)
+    {
+        m_file.unmap(m_pData);
+    }
+
+    m_pData = Q_NULLPTR;
+    m_mappedSize = 0;
+}
+
+void CHitJournal::recover()
+{
+    qint64 offset = m_headerSize;
+
+    while (offset + static_cast<qint64>(sizeof(SRecordHeader)) <= m_mappedSize)
+    {
+        SRecordHeader header;
+        memcpy(&header, m_pData + offset, sizeof(SRecordHeader));
+        if (header.Magic != m_recordMagic)
+        {
+            break;
+        }
+
+        qint64 recordSize = alignedSize(static_cast<qint64>(sizeof(SRecordHeader)) + header.Length);
+        if (offset + recordSize > m_mappedSize)
+        {
+            break;
+        }
+
+        // Stop at the first torn record, nothing valid follows it
+        const char* pPayload = reinterpret_cast<const char*>(m_pData + offset + sizeof(SRecordHeader));
+        if (header.Checksum != checksum(header, pPayload))
+        {
+            break;
+        }
+
+        m_nextId = qMax(m_nextId, header.Id + 1);
+        if (header.State == ERecordState_Pending)
+        {
+            QByteArray payload(pPayload, static_cast<int>(header.Length));
+
+            CHit hit(payload, QDateTime::fromMSecsSinceEpoch(header.TimeStamp));
+            hit.setJournalId(header.Id);
+
+            m_recoveredHits.append(hit);
+            m_pendingRecords.insert(header.Id, offset);
+        }
+        else
+        {
+            m_deadBytes += recordSize;
+        }
+
+        offset += recordSize;
+    }
+
+    m_writeOffset = offset;
+    if (m_writeOffset + static_cast<qint64>(sizeof(SRecordHeader)) <= m_mappedSize)
+    {
+        memset(m_pData + m_writeOffset, 0, sizeof(SRecordHeader));
+    }
+
+    if (m_deadBytes > 0)
+    {
+        compact();
+    }
+}
+
+void CHitJournal::compact()
+{
+    // Copy all pending records into a new image
+    QByteArray image(reinterpret_cast<const char*>(m_pData), static_cast<int>(m_headerSize));
+    QHash<quint64, qint64> pendingRecords;
+
+    qint64 offset = m_headerSize;
+    while (offset < m_writeOffset)
+    {
+        SRecordHeader header;
+        memcpy(&header, m_pData + offset, sizeof(SRecordHeader));
+
+        qint64 recordSize = alignedSize(static_cast<qint64>(sizeof(SRecordHeader)) + header.Length);
+        if ((header.State == ERecordState_Pending) && m_pendingRecords.contains(header.Id))
+        {
+            pendingRecords.insert(header.Id, image.size());
+            image.append(reinterpret_cast<const char*>(m_pData + offset), static_cast<int>(recordSize));
+        }
+
+        offset += recordSize;
+    }
+
+    qint64 size = qMax(m_initialSize, alignedSize(image.size() * 2));
+    QString fileName = m_file.fileName();
+
+    unmap();
+    m_file.close();
+
+    // Replace the journal atomically, a crash keeps the old file
+    QSaveFile saveFile(fileName);
+    if (saveFile.open(QIODevice::WriteOnly))
+    {
+        saveFile.write(image);
+        saveFile.write(QByteArray(static_cast<int>(size - image.size()), '\0'));
+        if (saveFile.commit())
+        {
+            m_pendingRecords = pendingRecords;
+            m_writeOffset = image.size();
+            m_deadBytes = 0;
+        }
+    }
+
+    if (!m_file.open(QIODevice::ReadWrite) || !map(m_file.size()))
+    {
+        qCWarning(lcQtAnalytics) << QString("Error reopening journal: %1").arg(m_file.errorString());
+        m_file.close();
+        m_pendingRecords.clear();
+    }
+}
+
+bool CHitJournal::reserve(qint64 size)
+{
+    if (m_writeOffset + size + static_cast<qint64>(sizeof(SRecordHeader)) <= m_mappedSize)
+    {
+        return true;
+    }
+
+    qint64 newSize = m_mappedSize;
+    while (m_writeOffset + size + static_cast<qint64>(sizeof(SRecordHeader)) > newSize)
+    {
+        newSize *= 2;
+    }
+
+    sync();
+    unmap();
+
+    if (!m_file.resize(newSize) || !map(newSize))
+    {
+        qCWarning(lcQtAnalytics) << QString("Error growing journal: %1").arg(m_file.errorString());
+        map(m_file.size());
+        return false;
+    }
+
+    return true;
+}
+
+qint64 CHitJournal::alignedSize(qint64 size)
+{
+    return (size + 7) & ~qint64(7);
+}
+
+quint32 CHitJournal::checksum(const SRecordHeader &header, const char* pPayload)
+{
+    quint32 crc = 0xffffffff;
+    crc = updateChecksum(crc, &header.Length, sizeof(header.Length));
+    crc = updateChecksum(crc, &header.Id, sizeof(header.Id));
+    crc = updateChecksum(crc, &header.TimeStamp, sizeof(header.TimeStamp));
+    crc = updateChecksum(crc, pPayload, header.Length);
+
+    return ~crc;
+}
+
+quint32 CHitJournal::updateChecksum(quint32 crc, const void* pData, qint64 length)
+{
+    // CRC-32 (IEEE 802.3), the table is built once by a thread-safe static initialization
+    struct SChecksumTable
+    {
+        SChecksumTable()
+        {
+            for (quint32 i = 0; i < 256; i++)
+            {
+                quint32 value = i;
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    value = (value & 1) ? (0xedb88320 ^ (value >> 1)) : (value >> 1);
+                }
+                Values[i] = value;
+            }
+        }
+
+        quint32 Values[256];
+    };
+
+    static const SChecksumTable table;
+
+    const uchar* pBytes = static_cast<const uchar*>(pData);
+    for (qint64 i = 0; i < length; i++)
+    {
+        crc = table.Values[(crc ^ pBytes[i]) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc;
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "qtanalytics_global.h"
+#include "hit.h"
+
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QTimer>
+
+QTANALYTICS_NAMESPACE_BEGIN
+
+///
+/// \brief Append-only, memory mapped journal of hits which have not been acknowledged yet.
+///
+/// Every hit is written as a checksummed record into the mapped file. Records are flagged
+/// when the hit is acknowledged and the file is compacted once enough of it is dead.
+/// Changes are flushed to disk in groups by a timer, not on every append.
+///
+class CHitJournal : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QString fileName READ fileName)
+    Q_PROPERTY(int commitInterval READ commitInterval WRITE setCommitInterval)
+
+public:
+    CHitJournal(QObject* pParent = Q_NULLPTR);
+    virtual ~CHitJournal();
+
+    ///
+    /// \brief Opens (or creates) the journal file and recovers pending hits from it.
+    ///
+    bool open(const QString &fileName);
+
+    ///
+    /// \brief Flushes and closes the journal file.
+    ///
+    void close();
+
+    bool isOpen() const;
+    QString fileName() const;
+
+    ///
+    /// \brief Gets or sets the interval in milliseconds in which appended hits are committed to disk. Default is 1000.
+    ///
+    int commitInterval() const;
+    void setCommitInterval(int value);
+
+    ///
+    /// \brief Takes the hits which were pending when the journal was opened, with their original timestamps.
+    ///
+    QList<CHit> takeRecoveredHits();
+
+    ///
+    /// \brief Appends the hit to the journal and returns its record id, 0 on failure.
+    ///
+    quint64 append(const CHit &hit);
+
+    ///
+    /// \brief Marks the record of the given hit as acknowledged.
+    ///
+    void acknowledge(const CHit &hit);
+
+    ///
+    /// \brief Commits all appended records to disk.
+    ///
+    void sync();
+
+private:
+    struct SRecordHeader
+    {
+        quint32 Magic;
+        quint32 Length;
+        quint64 Id;
+        qint64 TimeStamp;
+        quint32 Checksum;
+        quint8 State;
+        quint8 Reserved[3];
+    };
+
+    enum ERecordState
+    {
+        ERecordState_Pending = 1,
+        ERecordState_Acknowledged = 2
+    };
+
+    bool map(qint64 size);
+    void unmap();
+    void recover();
+    void compact();
+    bool reserve(qint64 size);
+
+    static qint64 alignedSize(qint64 size);
+    static quint32 checksum(const SRecordHeader &header, const char* pPayload);
+    static quint32 updateChecksum(quint32 crc, const void* pData, qint64 length);
+
+    static const quint32 m_fileMagic;
+    static const quint32 m_fileVersion;
+    static const quint32 m_recordMagic;
+    static const qint64 m_headerSize;
+    static const qint64 m_initialSize;
+    static const qint64 m_compactThreshold;
+
+    QFile m_file;
+    uchar* m_pData;
+    qint64 m_mappedSize;
+    qint64 m_writeOffset;
+    qint64 m_deadBytes;
+
+    quint64 m_nextId;
+    QHash<quint64, qint64> m_pendingRecords;
+    QList<CHit> m_recoveredHits;
+
+    QTimer* m_pCommitTimer;
+    bool m_isDirty;
+
+private slots:
+    void onCommitTimeout();
+};
+
+QTANALYTICS_NAMESPACE_END
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "hitparameters.h"
+
+#include <QStringList>
+#include <QUrl>
+
+QTANALYTICS_NAMESPACE_USING
+
+CHitParameters::CHitParameters()
+{
+}
+
+int CHitParameters::size() const
+{
+    return m_parameters.size();
+}
+
+bool CHitParameters::isEmpty() const
+{
+    return m_parameters.isEmpty();
+}
+
+EHitParameter CHitParameters::idAt(int index) const
+{
+    return m_parameters.at(index).Id;
+}
+
+int CHitParameters::parameterIndexAt(int index) const
+{
+    return m_parameters.at(index).Index;
+}
+
+QString CHitParameters::keyAt(int index) const
+{
+    const SParameter &parameter = m_parameters.at(index);
+    if (parameter.Id == EHitParameter_Custom)
+    {
+        return parameter.Key;
+    }
+
+    return QString::fromLatin1(CHitSchema::encodedKey(parameter.Id, parameter.Index));
+}
+
+QByteArray CHitParameters::encodedKeyAt(int index) const
+{
+    const SParameter &parameter = m_parameters.at(index);
+    if (parameter.Id == EHitParameter_Custom)
+    {
+        return QUrl::toPercentEncoding(parameter.Key);
+    }
+
+    return CHitSchema::encodedKey(parameter.Id, parameter.Index);
+}
+
+const QString &CHitParameters::valueAt(int index) const
+{
+    return m_parameters.at(index).Value;
+}
+
+bool CHitParameters::contains(EHitParameter id, int parameterIndex) const
+{
+    return indexOf(id, parameterIndex, QString()) >= 0;
+}
+
+bool CHitParameters::contains(const QString &key) const
+{
+    int parameterIndex = 0;
+    EHitParameter id = CHitSchema::parseKey(key, parameterIndex);
+
+    return indexOf(id, parameterIndex, key) >= 0;
+}
+
+QString CHitParameters::value(EHitParameter id, int parameterIndex) const
+{
+    int index = indexOf(id, parameterIndex, QString());
+    return (index >= 0) ? m_parameters.at(index).Value : QString();
+}
+
+QString CHitParameters::value(const QString &key) const
+{
+    int parameterIndex = 0;
+    EHitParameter id = CHitSchema::parseKey(key, parameterIndex);
+
+    int index = indexOf(id, parameterIndex, key);
+    return (index >= 0) ? m_parameters.at(index).Value : QString();
+}
+
+void CHitParameters::insert(EHitParameter id, const QString &value)
+{
+    Q_ASSERT_X(!hitParameterInfo(id).IsIndexed, "CHitParameters::insert", "indexed parameter without index");
+    insert(id, 0, QString(), value);
+}
+
+void CHitParameters::insert(EHitParameter id, int parameterIndex, const QString &value)
+{
+    Q_ASSERT_X(hitParameterInfo(id).IsIndexed && (parameterIndex >= 1) && (parameterIndex <= HitParameterMaxIndex), "CHitParameters::insert", "invalid parameter index");
+    insert(id, qBound(1, parameterIndex, HitParameterMaxIndex), QString(), value);
+}
+
+void CHitParameters::insert(const QString &key, const QString &value)
+{
+    int parameterIndex = 0;
+    EHitParameter id = CHitSchema::parseKey(key, parameterIndex);
+
+    insert(id, parameterIndex, (id == EHitParameter_Custom) ? key : QString(), value);
+}
+
+void CHitParameters::remove(EHitParameter id, int parameterIndex)
+{
+    int index = indexOf(id, parameterIndex, QString());
+    if (index >= 0)
+    {
+        m_parameters.remove(index);
+    }
+}
+
+void CHitParameters::remove(const QString &key)
+{
+    int parameterIndex = 0;
+    EHitParameter id = CHitSchema::parseKey(key, parameterIndex);
+
+    int index = indexOf(id, parameterIndex, key);
+    if (index >= 0)
+    {
+        m_parameters.remove(index);
+    }
+}
+
+void CHitParameters::encode(QByteArray &payload) const
+{
+    for (int i = 0; i < m_parameters.size(); i++)
+    {
+        encodeAt(i, payload);
+    }
+}
+
+void CHitParameters::encodeAt(int index, QByteArray &payload) const
+{
+    const SParameter &parameter = m_parameters.at(index);
+    if (parameter.Id == EHitParameter_Custom)
+    {
+        CHitSchema::appendParameter(payload, QUrl::toPercentEncoding(parameter.Key), parameter.Value, 0);
+    }
+    else
+    {
+        CHitSchema::appendParameter(payload, CHitSchema::encodedKey(parameter.Id, parameter.Index), parameter.Value, hitParameterInfo(parameter.Id).MaxLength);
+    }
+}
+
+QStringList CHitParameters::invalidKeys() const
+{
+    QStringList keys;
+
+    quint8 hitTypeMask = CHitSchema::hitTypeMask(value(EHitParameter_HitType));
+    for (int i = 0; i < m_parameters.size(); i++)
+    {
+        if (!(hitParameterInfo(m_parameters.at(i).Id).HitTypes & hitTypeMask))
+        {
+            keys.append(keyAt(i));
+        }
+    }
+
+    return keys;
+}
+
+QMap<QString, QString> CHitParameters::toMap() const
+{
+    QMap<QString, QString> data;
+    for (int i = 0; i < m_parameters.size(); i++)
+    {
+        data.insert(keyAt(i), m_parameters.at(i).Value);
+    }
+
+    return data;
+}
+
+CHitParameters CHitParameters::fromMap(const QMap<QString, QString> &data)
+{
+    CHitParameters parameters;
+    for(QMap<QString, QString>::const_iterator it = data.begin(), end = data.end(); it != end; ++it)
+    {
+        parameters.insert(it.key(), it.value());
+    }
+
+    return parameters;
+}
+
+int CHitParameters::indexOf(EHitParameter id, int parameterIndex, const QString &key) const
+{
+    for (int i = 0; i < m_parameters.size(); i++)
+    {
+        const SParameter &parameter = m_parameters.at(i);
+        if ((parameter.Id == id) && (parameter.Index == parameterIndex) && ((id != EHitParameter_Custom) || (parameter.Key == key)))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void CHitParameters::insert(EHitParameter id, int parameterIndex, const QString &key, const QString &value)
+{
+    int index = indexOf(id, parameterIndex, key);
+    if (index >= 0)
+    {
+        m_parameters[index].Value = value;
+    }
+    else
+    {
+        SParameter parameter;
+        parameter.Id = id;
+        parameter.Index = static_cast<quint8>(parameterIndex);
+        parameter.Key = key;
+        parameter.Value = value;
+        m_parameters.append(parameter);
+    }
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "qtanalytics_global.h"
+#include "hitschema.h"
+
+#include <QByteArray>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QVarLengthArray>
+
+QTANALYTICS_NAMESPACE_BEGIN
+
+///
+/// \brief Flat list of hit parameters in insertion order.
+///
+/// Parameters are stored as schema id, index and value. Only parameters unknown to
+/// CHitSchema keep their key as string. Up to 16 parameters are stored inline, which
+/// covers typical hits without any allocation for the container itself. Setting a
+/// parameter which is already present replaces its value.
+///
+class CHitParameters
+{
+public:
+    CHitParameters();
+
+    int size() const;
+    bool isEmpty() const;
+
+    EHitParameter idAt(int index) const;
+    int parameterIndexAt(int index) const;
+    QString keyAt(int index) const;
+    QByteArray encodedKeyAt(int index) const;
+    const QString &valueAt(int index) const;
+
+    bool contains(EHitParameter id, int parameterIndex = 0) const;
+    bool contains(const QString &key) const;
+
+    QString value(EHitParameter id, int parameterIndex = 0) const;
+    QString value(const QString &key) const;
+
+    void insert(EHitParameter id, const QString &value);
+    void insert(EHitParameter id, int parameterIndex, const QString &value);
+    void insert(const QString &key, const QString &value);
+
+    void remove(EHitParameter id, int parameterIndex = 0);
+    void remove(const QString &key);
+
+    ///
+    /// \brief Appends all parameters percent encoded to the payload.
+    ///
+    void encode(QByteArray &payload) const;
+    void encodeAt(int index, QByteArray &payload) const;
+
+    ///
+    /// \brief Returns the parameters which do not apply to the hit type of this hit.
+    ///
+    QStringList invalidKeys() const;
+
+    QMap<QString, QString> toMap() const;
+    static CHitParameters fromMap(const QMap<QString, QString> &data);
+
+private:
+    struct SParameter
+    {
+        EHitParameter Id;
+        quint8 Index;
+        QString Key;
+        QString Value;
+    };
+
+    int indexOf(EHitParameter id, int parameterIndex, const QString &key) const;
+    void insert(EHitParameter id, int parameterIndex, const QString &key, const QString &value);
+
+    QVarLengthArray<SParameter, 16> m_parameters;
+};
+
+QTANALYTICS_NAMESPACE_END
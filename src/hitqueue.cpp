@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "hitqueue.h"
+
+#include <climits>
+
+QTANALYTICS_NAMESPACE_USING
+
+const int CHitQueue::m_dropPriorityCount;
+
+CHitQueue::CHitQueue()
+    : m_frontSequence(0)
+    , m_backSequence(1)
+    , m_size(0)
+    , m_bytes(0)
+{
+    for (int lane = 0; lane < EHitPriority_Count; lane++)
+    {
+        m_laneSizes[lane] = 0;
+        m_credits[lane] = 0;
+    }
+
+    for (int dropPriority = 0; dropPriority < m_dropPriorityCount; dropPriority++)
+    {
+        m_dropPrioritySizes[dropPriority] = 0;
+    }
+}
+
+bool CHitQueue::isEmpty() const
+{
+    return (m_size == 0);
+}
+
+int CHitQueue::size() const
+{
+    return m_size;
+}
+
+qint64 CHitQueue::bytes() const
+{
+    return m_bytes;
+}
+
+const CHit &CHitQueue::head() const
+{
+    int lane = nextLane();
+
+    return m_queues[lane][oldestDropPriority(lane)].head().Hit;
+}
+
+CHit CHitQueue::dequeue()
+{
+    int lane = nextLane();
+
+    // Smooth weighted round robin, every waiting lane earns its weight and the served lane pays for all
+    int totalWeight = 0;
+    for (int i = 0; i < EHitPriority_Count; i++)
+    {
+        if (m_laneSizes[i] > 0)
+        {
+            m_credits[i] += laneWeight(i);
+            totalWeight += laneWeight(i);
+        }
+    }
+
+    m_credits[lane] -= totalWeight;
+
+    return takeFrom(lane, oldestDropPriority(lane));
+}
+
+void CHitQueue::append(const CHit &hit)
+{
+    int lane = hit.getPriority();
+    int priority = dropPriority(hit);
+
+    SEntry entry = { m_backSequence++, hit };
+    m_queues[lane][priority].append(entry);
+    m_laneSizes[lane]++;
+    m_dropPrioritySizes[priority]++;
+    m_size++;
+    m_bytes += hit.getPayload().size();
+}
+
+void CHitQueue::prepend(const CHit &hit)
+{
+    int lane = hit.getPriority();
+    int priority = dropPriority(hit);
+
+    SEntry entry = { m_frontSequence--, hit };
+    m_queues[lane][priority].prepend(entry);
+    m_laneSizes[lane]++;
+    m_dropPrioritySizes[priority]++;
+    m_size++;
+    m_bytes += hit.getPayload().size();
+}
+
+CHit CHitQueue::takeOldest()
+{
+    // Regardless of the lane, the hit which would have been the head of a single queue
+    int oldestLane = -1;
+    int oldestPriority = -1;
+    for (int lane = 0; lane < EHitPriority_Count; lane++)
+    {
+        if (m_laneSizes[lane] == 0)
+        {
+            continue;
+        }
+
+        int priority = oldestDropPriority(lane);
+        if ((oldestLane < 0) || (m_queues[lane][priority].head().Sequence < m_queues[oldestLane][oldestPriority].head().Sequence))
+        {
+            oldestLane = lane;
+            oldestPriority = priority;
+        }
+    }
+
+    return takeFrom(oldestLane, oldestPriority);
+}
+
+int CHitQueue::lowestPriority() const
+{
+    for (int dropPriority = 0; dropPriority < m_dropPriorityCount; dropPriority++)
+    {
+        if (m_dropPrioritySizes[dropPriority] > 0)
+        {
+            return dropPriority;
+        }
+    }
+
+    return INT_MAX;
+}
+
+CHit CHitQueue::takeLowestPriority()
+{
+    int priority = lowestPriority();
+
+    // The oldest of the lowest drop priority is the head of one of its queues
+    int oldestLane = -1;
+    for (int lane = 0; lane < EHitPriority_Count; lane++)
+    {
+        const QQueue<SEntry> &queue = m_queues[lane][priority];
+        if (!queue.isEmpty() && ((oldestLane < 0) || (queue.head().Sequence < m_queues[oldestLane][priority].head().Sequence)))
+        {
+            oldestLane = lane;
+        }
+    }
+
+    return takeFrom(oldestLane, priority);
+}
+
+QList<CHit> CHitQueue::takeExpired(const QDateTime &limit)
+{
+    QList<CHit> expiredHits;
+    for (int lane = 0; lane < EHitPriority_Count; lane++)
+    {
+        for (int priority = 0; priority < m_dropPriorityCount; priority++)
+        {
+            QQueue<SEntry> &queue = m_queues[lane][priority];
+            for (int i = queue.size() - 1; i >= 0; --i)
+            {
+                if (queue.at(i).Hit.getTimeStamp() < limit)
+                {
+                    CHit hit = queue.takeAt(i).Hit;
+                    m_laneSizes[lane]--;
+                    m_dropPrioritySizes[priority]--;
+                    m_size--;
+                    m_bytes -= hit.getPayload().size();
+                    expiredHits.append(hit);
+                }
+            }
+        }
+
+        if (m_laneSizes[lane] == 0)
+        {
+            m_credits[lane] = 0;
+        }
+    }
+
+    return expiredHits;
+}
+
+void CHitQueue::forEach(const std::function<void (CHit &)> &function)
+{
+    for (int lane = 0; lane < EHitPriority_Count; lane++)
+    {
+        for (int priority = 0; priority < m_dropPriorityCount; priority++)
+        {
+            for (QQueue<SEntry>::iterator it = m_queues[lane][priority].begin(), end = m_queues[lane][priority].end(); it != end; ++it)
+            {
+                function(it->Hit);
+            }
+        }
+    }
+}
+
+int CHitQueue::dropPriority(const CHit &hit)
+{
+    switch (hit.getHitType())
+    {
+    case EHitTypeMask_Exception:
+        return 3;
+    case EHitTypeMask_Event:
+    case EHitTypeMask_Transaction:
+    case EHitTypeMask_Item:
+        return 2;
+    case EHitTypeMask_Timing:
+        return 0;
+    default:
+        return 1;
+    }
+}
+
+int CHitQueue::laneWeight(int lane)
+{
+    switch (lane)
+    {
+    case EHitPriority_Critical:
+        return 16;
+    case EHitPriority_Normal:
+        return 4;
+    default:
+        return 1;
+    }
+}
+
+int CHitQueue::nextLane() const
+{
+    // The lane with the most credit after this round is served, ties go to the more important lane
+    int nextLane = -1;
+    int maxCredit = INT_MIN;
+    for (int lane = 0; lane < EHitPriority_Count; lane++)
+    {
+        if ((m_laneSizes[lane] > 0) && (m_credits[lane] + laneWeight(lane) > maxCredit))
+        {
+            maxCredit = m_credits[lane] + laneWeight(lane);
+            nextLane = lane;
+        }
+    }
+
+    return nextLane;
+}
+
+int CHitQueue::oldestDropPriority(int lane) const
+{
+    // The head of a lane is the smallest sequence number among the heads of its queues
+    int oldest = -1;
+    for (int priority = 0; priority < m_dropPriorityCount; priority++)
+    {
+        const QQueue<SEntry> &queue = m_queues[lane][priority];
+        if (!queue.isEmpty() && ((oldest < 0) || (queue.head().Sequence < m_queues[lane][oldest].head().Sequence)))
+        {
+            oldest = priority;
+        }
+    }
+
+    return oldest;
+}
+
+CHit CHitQueue::takeFrom(int lane, int dropPriority)
+{
+    CHit hit = m_queues[lane][dropPriority].dequeue().Hit;
+    m_laneSizes[lane]--;
+    m_dropPrioritySizes[dropPriority]--;
+    m_size--;
+    m_bytes -= hit.getPayload().size();
+
+    // An idle lane must not save up credit for later
+    if (m_laneSizes[lane] == 0)
+    {
+        m_credits[lane] = 0;
+    }
+
+    return hit;
+}
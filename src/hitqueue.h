@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "qtanalytics_global.h"
+#include "hit.h"
+
+#include <QList>
+#include <QQueue>
+
+#include <functional>
+
+QTANALYTICS_NAMESPACE_BEGIN
+
+///
+/// \brief Queue of hits waiting to be sent, keeps track of the payload bytes it holds.
+///
+/// Every EHitPriority has its own FIFO lane. Lanes are served by smooth weighted round robin,
+/// so critical hits are sent ahead of a backlog while lower lanes still get a share of the
+/// requests and never starve.
+///
+/// Each lane is split by drop priority and every hit gets a sequence number, so the order
+/// within a lane is kept and the victim of an overflow is found without scanning the queue.
+///
+class CHitQueue
+{
+public:
+    CHitQueue();
+
+    bool isEmpty() const;
+    int size() const;
+
+    ///
+    /// \brief Gets the number of payload bytes of all queued hits.
+    ///
+    qint64 bytes() const;
+
+    ///
+    /// \brief Gets the hit which is sent next.
+    ///
+    const CHit &head() const;
+    CHit dequeue();
+
+    ///
+    /// \brief Appends the hit at the end of its lane.
+    ///
+    void append(const CHit &hit);
+
+    ///
+    /// \brief Puts the hit back in front of its lane.
+    ///
+    void prepend(const CHit &hit);
+
+    ///
+    /// \brief Removes and returns the oldest hit of all lanes, the head in the order hits were queued.
+    ///
+    CHit takeOldest();
+
+    ///
+    /// \brief Gets the lowest drop priority of all queued hits.
+    ///
+    int lowestPriority() const;
+
+    ///
+    /// \brief Removes and returns the oldest hit with the lowest drop priority.
+    ///
+    CHit takeLowestPriority();
+
+    ///
+    /// \brief Removes and returns all hits created before the given time.
+    ///
+    QList<CHit> takeExpired(const QDateTime &limit);
+
+    void forEach(const std::function<void (CHit &)> &function);
+
+    ///
+    /// \brief Gets the priority of a hit when the queue overflows, lower values are dropped first.
+    ///
+    static int dropPriority(const CHit &hit);
+
+    ///
+    /// \brief Gets the share of requests a lane gets while other lanes are waiting.
+    ///
+    static int laneWeight(int lane);
+
+private:
+    struct SEntry
+    {
+        qint64 Sequence;
+        CHit Hit;
+    };
+
+    static const int m_dropPriorityCount = 4;
+
+    int nextLane() const;
+    int oldestDropPriority(int lane) const;
+    CHit takeFrom(int lane, int dropPriority);
+
+    // Appended hits count up, requeued ones count down, so the smallest number is the oldest
+    QQueue<SEntry> m_queues[EHitPriority_Count][m_dropPriorityCount];
+    int m_laneSizes[EHitPriority_Count];
+    int m_dropPrioritySizes[m_dropPriorityCount];
+    int m_credits[EHitPriority_Count];
+    qint64 m_frontSequence;
+    qint64 m_backSequence;
+    int m_size;
+    qint64 m_bytes;
+};
+
+QTANALYTICS_NAMESPACE_END
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "hitschema.h"
+#include "analyticslogging.h"
+
+#include <QHash>
+
+QTANALYTICS_NAMESPACE_USING
+
+namespace
+{
+    struct SInternedKeys
+    {
+        SInternedKeys()
+        {
+            for (int i = 0; i < HitParameterSchemaSize; i++)
+            {
+                const SHitParameterInfo &info = HitParameterSchema[i];
+                Keys[i] = QByteArray(info.Key, info.KeyLength);
+
+                if (!info.IsIndexed && (info.KeyLength > 0))
+                {
+                    Lookup.insert(QString::fromLatin1(info.Key, info.KeyLength), info.Id);
+                }
+            }
+
+            for (int index = 1; index <= HitParameterMaxIndex; index++)
+            {
+                DimensionKeys[index] = Keys[EHitParameter_CustomDimension] + QByteArray::number(index);
+                MetricKeys[index] = Keys[EHitParameter_CustomMetric] + QByteArray::number(index);
+            }
+        }
+
+        QByteArray Keys[HitParameterSchemaSize];
+        QByteArray DimensionKeys[HitParameterMaxIndex + 1];
+        QByteArray MetricKeys[HitParameterMaxIndex + 1];
+        QHash<QString, EHitParameter> Lookup;
+    };
+}
+
+Q_GLOBAL_STATIC(SInternedKeys, internedKeys)
+
+EHitParameter CHitSchema::parseKey(const QString &key, int &index)
+{
+    index = 0;
+
+    QHash<QString, EHitParameter>::const_iterator it = internedKeys()->Lookup.constFind(key);
+    if (it != internedKeys()->Lookup.constEnd())
+    {
+        return it.value();
+    }
+
+    // Indexed parameters like cd12 or cm3, cd01 is a custom key and must not collide with cd1
+    if ((key.size() > 2) && (key.size() <= 5) && (key.at(0) == QLatin1Char('c')) && key.at(2).isDigit() && (key.at(2) != QLatin1Char('0')))
+    {
+        bool isNumber = false;
+        int value = key.midRef(2).toInt(&isNumber);
+        if (isNumber && (value >= 1) && (value <= HitParameterMaxIndex))
+        {
+            if (key.at(1) == QLatin1Char('d'))
+            {
+                index = value;
+                return EHitParameter_CustomDimension;
+            }
+            else if (key.at(1) == QLatin1Char('m'))
+            {
+                index = value;
+                return EHitParameter_CustomMetric;
+            }
+        }
+    }
+
+    return EHitParameter_Custom;
+}
+
+QByteArray CHitSchema::encodedKey(EHitParameter id, int index)
+{
+    if (id == EHitParameter_CustomDimension)
+    {
+        return internedKeys()->DimensionKeys[qBound(1, index, HitParameterMaxIndex)];
+    }
+    else if (id == EHitParameter_CustomMetric)
+    {
+        return internedKeys()->MetricKeys[qBound(1, index, HitParameterMaxIndex)];
+    }
+
+    return internedKeys()->Keys[id];
+}
+
+quint8 CHitSchema::hitTypeMask(const QString &hitType)
+{
+    if (hitType == QLatin1String("screenview")) return EHitTypeMask_Screenview;
+    if (hitType == QLatin1String("event")) return EHitTypeMask_Event;
+    if (hitType == QLatin1String("exception")) return EHitTypeMask_Exception;
+    if (hitType == QLatin1String("timing")) return EHitTypeMask_Timing;
+    if (hitType == QLatin1String("pageview")) return EHitTypeMask_Pageview;
+    if (hitType == QLatin1String("transaction")) return EHitTypeMask_Transaction;
+    if (hitType == QLatin1String("item")) return EHitTypeMask_Item;
+    if (hitType == QLatin1String("social")) return EHitTypeMask_Social;
+
+    return EHitTypeMask_None;
+}
+
+bool CHitSchema::isApplicable(EHitParameter id, const QString &hitType)
+{
+    return (hitParameterInfo(id).HitTypes & hitTypeMask(hitType)) != 0;
+}
+
+void CHitSchema::appendParameter(QByteArray &payload, const QByteArray &encodedKey, const QString &value, int maxLength)
+{
+    QByteArray utf8 = value.toUtf8();
+    if ((maxLength > 0) && (utf8.size() > maxLength))
+    {
+        // Cut at a character boundary
+        int length = maxLength;
+        while ((length > 0) && ((static_cast<uchar>(utf8.at(length)) & 0xc0) == 0x80))
+        {
+            length--;
+        }
+
+        qCDebug(lcQtAnalytics) << "Truncating parameter" << encodedKey << "from" << utf8.size() << "to" << length << "bytes";
+        utf8.truncate(length);
+    }
+
+    if (!payload.isEmpty())
+    {
+        payload.append('&');
+    }
+
+    payload.append(encodedKey);
+    payload.append('=');
+    payload.append(utf8.toPercentEncoding());
+}
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "qtanalytics_global.h"
+
+#include <QByteArray>
+#include <QString>
+
+QTANALYTICS_NAMESPACE_BEGIN
+
+///
+/// \brief Parameters of the measurement protocol known to QtAnalytics.
+///
+/// The value is the index into the schema table, EHitParameter_Custom marks
+/// parameters which are only known by their key.
+///
+enum EHitParameter : quint8
+{
+    EHitParameter_ProtocolVersion,
+    EHitParameter_TrackingId,
+    EHitParameter_AnonymizeIp,
+    EHitParameter_QueueTime,
+    EHitParameter_CacheBuster,
+    EHitParameter_ClientId,
+    EHitParameter_UserId,
+    EHitParameter_SessionControl,
+    EHitParameter_IpOverride,
+    EHitParameter_UserAgentOverride,
+    EHitParameter_GeographicalOverride,
+    EHitParameter_DocumentReferrer,
+    EHitParameter_ScreenResolution,
+    EHitParameter_ViewportSize,
+    EHitParameter_DocumentEncoding,
+    EHitParameter_ScreenColors,
+    EHitParameter_UserLanguage,
+    EHitParameter_HitType,
+    EHitParameter_NonInteraction,
+    EHitParameter_DocumentLocation,
+    EHitParameter_DocumentHostName,
+    EHitParameter_DocumentPath,
+    EHitParameter_DocumentTitle,
+    EHitParameter_ScreenName,
+    EHitParameter_ApplicationName,
+    EHitParameter_ApplicationId,
+    EHitParameter_ApplicationVersion,
+    EHitParameter_ApplicationInstallerId,
+    EHitParameter_EventCategory,
+    EHitParameter_EventAction,
+    EHitParameter_EventLabel,
+    EHitParameter_EventValue,
+    EHitParameter_UserTimingCategory,
+    EHitParameter_UserTimingVariable,
+    EHitParameter_UserTimingTime,
+    EHitParameter_UserTimingLabel,
+    EHitParameter_ExceptionDescription,
+    EHitParameter_ExceptionFatal,
+    EHitParameter_CustomDimension,
+    EHitParameter_CustomMetric,
+    EHitParameter_Custom
+};
+
+///
+/// \brief Hit types a parameter applies to, as bit mask.
+///
+enum EHitTypeMask : quint8
+{
+    EHitTypeMask_None = 0x00,
+    EHitTypeMask_Pageview = 0x01,
+    EHitTypeMask_Screenview = 0x02,
+    EHitTypeMask_Event = 0x04,
+    EHitTypeMask_Transaction = 0x08,
+    EHitTypeMask_Item = 0x10,
+    EHitTypeMask_Social = 0x20,
+    EHitTypeMask_Exception = 0x40,
+    EHitTypeMask_Timing = 0x80,
+    EHitTypeMask_All = 0xff
+};
+
+struct SHitParameterInfo
+{
+    EHitParameter Id;
+    const char* Key;
+    int KeyLength;
+    int MaxLength;      // In bytes, 0 when unlimited
+    quint8 HitTypes;
+    bool IsIndexed;     // Key is followed by an index, e.g. cd1
+};
+
+///
+/// \brief Schema of all known parameters, ordered by EHitParameter.
+///
+constexpr SHitParameterInfo HitParameterSchema[] =
+{
+    { EHitParameter_ProtocolVersion,        "v",     1, 0,    EHitTypeMask_All,        false },
+    { EHitParameter_TrackingId,             "tid",   3, 0,    EHitTypeMask_All,        false },
+    { EHitParameter_AnonymizeIp,            "aip",   3, 0,    EHitTypeMask_All,        false },
+    { EHitParameter_QueueTime,              "qt",    2, 0,    EHitTypeMask_All,        false },
+    { EHitParameter_CacheBuster,            "z",     1, 0,    EHitTypeMask_All,        false },
+    { EHitParameter_ClientId,               "cid",   3, 0,    EHitTypeMask_All,        false },
+    { EHitParameter_UserId,                 "uid",   3, 0,    EHitTypeMask_All,        false },
+    { EHitParameter_SessionControl,         "sc",    2, 0,    EHitTypeMask_All,        false },
+    { EHitParameter_IpOverride,             "uip",   3, 0,    EHitTypeMask_All,        false },
+    { EHitParameter_UserAgentOverride,      "ua",    2, 0,    EHitTypeMask_All,        false },
+    { EHitParameter_GeographicalOverride,   "geoid", 5, 0,    EHitTypeMask_All,        false },
+    { EHitParameter_DocumentReferrer,       "dr",    2, 2048, EHitTypeMask_All,        false },
+    { EHitParameter_ScreenResolution,       "sr",    2, 20,   EHitTypeMask_All,        false },
+    { EHitParameter_ViewportSize,           "vp",    2, 20,   EHitTypeMask_All,        false },
+    { EHitParameter_DocumentEncoding,       "de",    2, 20,   EHitTypeMask_All,        false },
+    { EHitParameter_ScreenColors,           "sd",    2, 20,   EHitTypeMask_All,        false },
+    { EHitParameter_UserLanguage,           "ul",    2, 20,   EHitTypeMask_All,        false },
+    { EHitParameter_HitType,                "t",     1, 0,    EHitTypeMask_All,        false },
+    { EHitParameter_NonInteraction,         "ni",    2, 0,    EHitTypeMask_All,        false },
+    { EHitParameter_DocumentLocation,       "dl",    2, 2048, EHitTypeMask_All,        false },
+    { EHitParameter_DocumentHostName,       "dh",    2, 100,  EHitTypeMask_All,        false },
+    { EHitParameter_DocumentPath,           "dp",    2, 2048, EHitTypeMask_All,        false },
+    { EHitParameter_DocumentTitle,          "dt",    2, 1500, EHitTypeMask_All,        false },
+    { EHitParameter_ScreenName,             "cd",    2, 2048, EHitTypeMask_All,        false },
+    { EHitParameter_ApplicationName,        "an",    2, 100,  EHitTypeMask_All,        false },
+    { EHitParameter_ApplicationId,          "aid",   3, 150,  EHitTypeMask_All,        false },
+    { EHitParameter_ApplicationVersion,     "av",    2, 100,  EHitTypeMask_All,        false },
+    { EHitParameter_ApplicationInstallerId, "aiid",  4, 150,  EHitTypeMask_All,        false },
+    { EHitParameter_EventCategory,          "ec",    2, 150,  EHitTypeMask_Event,      false },
+    { EHitParameter_EventAction,            "ea",    2, 500,  EHitTypeMask_Event,      false },
+    { EHitParameter_EventLabel,             "el",    2, 500,  EHitTypeMask_Event,      false },
+    { EHitParameter_EventValue,             "ev",    2, 0,    EHitTypeMask_Event,      false },
+    { EHitParameter_UserTimingCategory,     "utc",   3, 150,  EHitTypeMask_Timing,     false },
+    { EHitParameter_UserTimingVariable,     "utv",   3, 500,  EHitTypeMask_Timing,     false },
+    { EHitParameter_UserTimingTime,         "utt",   3, 0,    EHitTypeMask_Timing,     false },
+    { EHitParameter_UserTimingLabel,        "utl",   3, 500,  EHitTypeMask_Timing,     false },
+    { EHitParameter_ExceptionDescription,   "exd",   3, 150,  EHitTypeMask_Exception,  false },
+    { EHitParameter_ExceptionFatal,         "exf",   3, 0,    EHitTypeMask_Exception,  false },
+    { EHitParameter_CustomDimension,        "cd",    2, 150,  EHitTypeMask_All,        true  },
+    { EHitParameter_CustomMetric,           "cm",    2, 0,    EHitTypeMask_All,        true  },
+    { EHitParameter_Custom,                 "",      0, 0,    EHitTypeMask_All,        false }
+};
+
+constexpr int HitParameterSchemaSize = sizeof(HitParameterSchema) / sizeof(HitParameterSchema[0]);
+
+///
+/// \brief Highest index of custom dimensions and metrics.
+///
+constexpr int HitParameterMaxIndex = 200;
+
+constexpr bool isHitParameterKeyLengthValid(const char* pKey, int length)
+{
+    return (length == 0) ? (*pKey == '\0') : ((*pKey != '\0') && isHitParameterKeyLengthValid(pKey + 1, length - 1));
+}
+
+constexpr bool isHitParameterSchemaValid(int index)
+{
+    return (index >= HitParameterSchemaSize)
+        || ((HitParameterSchema[index].Id == index)
+            && isHitParameterKeyLengthValid(HitParameterSchema[index].Key, HitParameterSchema[index].KeyLength)
+            && isHitParameterSchemaValid(index + 1));
+}
+
+static_assert(isHitParameterSchemaValid(0), "HitParameterSchema must be ordered by EHitParameter and have valid key lengths");
+static_assert(HitParameterSchemaSize == EHitParameter_Custom + 1, "HitParameterSchema must cover every EHitParameter");
+static_assert(HitParameterMaxIndex <= 255, "Parameter index must fit into a byte");
+
+constexpr const SHitParameterInfo &hitParameterInfo(EHitParameter id)
+{
+    return HitParameterSchema[id];
+}
+
+class CHitSchema
+{
+public:
+    ///
+    /// \brief Looks up the parameter for a key like "ec" or "cd12", returns EHitParameter_Custom for unknown keys.
+    ///
+    static EHitParameter parseKey(const QString &key, int &index);
+
+    ///
+    /// \brief Gets the encoded key of a parameter, indexed keys are interned and not formatted again.
+    ///
+    static QByteArray encodedKey(EHitParameter id, int index);
+
+    ///
+    /// \brief Gets the hit type mask of the value of the 't' parameter.
+    ///
+    static quint8 hitTypeMask(const QString &hitType);
+
+    ///
+    /// \brief Returns whether the parameter may be sent with the given hit type.
+    ///
+    static bool isApplicable(EHitParameter id, const QString &hitType);
+
+    ///
+    /// \brief Appends key=value to the payload, percent encoding and truncating the value to the schema limit.
+    ///
+    static void appendParameter(QByteArray &payload, const QByteArray &encodedKey, const QString &value, int maxLength);
+};
+
+QTANALYTICS_NAMESPACE_END
@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "httptransport.h"
+#include "analyticslogging.h"
+#include "analyticsmanager.h"
+
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSslConfiguration>
+#include <QUrl>
+
+QTANALYTICS_NAMESPACE_USING
+
+QString CHttpTransport::m_endPointUnsecureDebug = QString("http://www.google-analytics.com/debug/collect");
+QString CHttpTransport::m_endPointSecureDebug = QString("https://ssl.google-analytics.com/debug/collect");
+QString CHttpTransport::m_endPointUnsecure = QString("http://www.google-analytics.com/collect");
+QString CHttpTransport::m_endPointSecure = QString("https://ssl.google-analytics.com/collect");
+QString CHttpTransport::m_endPointUnsecureDebugBatch = QString("http://www.google-analytics.com/debug/batch");
+QString CHttpTransport::m_endPointSecureDebugBatch = QString("https://ssl.google-analytics.com/debug/batch");
+QString CHttpTransport::m_endPointUnsecureBatch = QString("http://www.google-analytics.com/batch");
+QString CHttpTransport::m_endPointSecureBatch = QString("https://ssl.google-analytics.com/batch");
+
+// QNetworkAccessManager closes connections which were idle for two minutes
+const qint64 CHttpTransport::m_connectionExpiry = 120 * 1000;
+
+CHttpTransport::CHttpTransport(CAnalyticsManager* pAnalyticsManager, const CAnalyticsManager::SSettings &settings)
+    : ITransport()
+    , m_pAnalyticsManager(pAnalyticsManager)
+    , m_settings(settings)
+    , m_pNetworkAccessManager(new QNetworkAccessManager(this))
+{
+    // Only requests which open a connection perform a handshake, the others reuse one
+    connect(m_pNetworkAccessManager, &QNetworkAccessManager::encrypted, this, &CHttpTransport::onEncrypted);
+}
+
+CHttpTransport::~CHttpTransport()
+{
+}
+
+void CHttpTransport::setSettings(const CAnalyticsManager::SSettings &settings)
+{
+    m_settings = settings;
+}
+
+bool CHttpTransport::supportsBatch() const
+{
+    // Batches are only supported by post requests
+    return m_settings.PostData;
+}
+
+void CHttpTransport::send(quint64 requestId, const QList<QByteArray> &payloads)
+{
+    // Single hits go to the collect endpoint, which also validates them in debug mode
+    bool isBatch = (payloads.size() > 1);
+    QString endPoint = getEndPoint(isBatch);
+
+    QByteArray ba;
+    for (QList<QByteArray>::const_iterator it = payloads.constBegin(), end = payloads.constEnd(); it != end; ++it)
+    {
+        if (!ba.isEmpty()) ba.append('\n');
+        ba.append(*it);
+    }
+
+    // The header value is formatted once per platform change, not per request
+    TPlatformSnapshotPtr pPlatformSnapshot = m_pAnalyticsManager->platformInfoProvider()->getSnapshot();
+
+    QNetworkReply* reply = Q_NULLPTR;
+    if (m_settings.PostData)
+    {
+        // Prepare network request for post
+        QNetworkRequest request(endPoint);
+        request.setRawHeader("User-Agent", pPlatformSnapshot->getUserAgentHeader());
+        request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
+        request.setHeader(QNetworkRequest::ContentLengthHeader, ba.length());
+        request.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+
+        reply = m_pNetworkAccessManager->post(request, ba);
+    }
+    else
+    {
+        // Perform get request
+        QNetworkRequest request(QUrl::fromEncoded(endPoint.toUtf8() + "?" + ba));
+        request.setRawHeader("User-Agent", pPlatformSnapshot->getUserAgentHeader());
+        request.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+
+        reply = m_pNetworkAccessManager->get(request);
+    }
+
+    if (!m_settings.IsSecure)
+    {
+        countPlainConnection();
+    }
+
+    m_pAnalyticsManager->metrics()->addRequests(1);
+
+    reply->setProperty("requestId", requestId);
+    reply->setProperty("hitCount", payloads.size());
+    reply->setProperty("isBatch", isBatch);
+    connect(reply, &QNetworkReply::finished, this, &CHttpTransport::onReplyFinished);
+}
+
+void CHttpTransport::warmUp()
+{
+    // Resolve, connect and, for SSL, handshake with the collector ahead of the first request
+    QUrl url(getEndPoint(false));
+    if (m_settings.IsSecure)
+    {
+        // Requests allow HTTP/2, a connection without ALPN h2 is cached apart and never reused by them
+        QSslConfiguration sslConfiguration = QSslConfiguration::defaultConfiguration();
+        sslConfiguration.setAllowedNextProtocols(QList<QByteArray>() << QSslConfiguration::ALPNProtocolHTTP2 << QSslConfiguration::NextProtocolHttp1_1);
+        m_pNetworkAccessManager->connectToHostEncrypted(url.host(), static_cast<quint16>(url.port(443)), sslConfiguration);
+    }
+    else
+    {
+        countPlainConnection();
+        m_pNetworkAccessManager->connectToHost(url.host(), static_cast<quint16>(url.port(80)));
+    }
+}
+
+void CHttpTransport::onEncrypted(QNetworkReply* reply)
+{
+    Q_UNUSED(reply)
+    m_pAnalyticsManager->metrics()->addNewConnections(1);
+}
+
+void CHttpTransport::onReplyFinished()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    reply->deleteLater();
+    m_lastActivity.start();
+
+    quint64 requestId = reply->property("requestId").toULongLong();
+    QVector<ETransportResult> results(reply->property("hitCount").toInt(), ETransportResult_Delivered);
+
+    int httpStausCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (httpStausCode < 200 || httpStausCode > 299)
+    {
+        // An error ocurred, none of the hits went through.
+        results.fill(isPermanentError(httpStausCode) ? ETransportResult_Rejected : ETransportResult_Failed);
+        emit finished(requestId, results, QString("HTTP status %1: %2").arg(httpStausCode).arg(reply->errorString()));
+        return;
+    }
+
+    if (m_settings.IsDebug && reply->property("isBatch").toBool())
+    {
+        markInvalidBatchHits(results, reply->readAll());
+    }
+
+    emit finished(requestId, results, QString());
+}
+
+QString CHttpTransport::getEndPoint(bool isBatch) const
+{
+    bool isDebug = m_settings.IsDebug;
+    bool isSecure = m_settings.IsSecure;
+
+    if (isBatch)
+    {
+        return isDebug ? (isSecure ? m_endPointSecureDebugBatch : m_endPointUnsecureDebugBatch) : (isSecure ? m_endPointSecureBatch : m_endPointUnsecureBatch);
+    }
+
+    return isDebug ? (isSecure ? m_endPointSecureDebug : m_endPointUnsecureDebug) : (isSecure ? m_endPointSecure : m_endPointUnsecure);
+}
+
+void CHttpTransport::countPlainConnection()
+{
+    // The access manager reports handshakes only, a plain connection is new when the last one expired
+    if (!m_lastActivity.isValid() || (m_lastActivity.elapsed() > m_connectionExpiry))
+    {
+        m_pAnalyticsManager->metrics()->addNewConnections(1);
+    }
+
+    m_lastActivity.start();
+}
+
+void CHttpTransport::markInvalidBatchHits(QVector<ETransportResult> &results, const QByteArray &response)
+{
+    // The debug endpoint reports a parsing result for every hit of the batch
+    QJsonArray parsingResults = QJsonDocument::fromJson(response).object().value("hitParsingResult").toArray();
+    for (int i = qMin(parsingResults.size(), results.size()) - 1; i >= 0; --i)
+    {
+        QJsonObject result = parsingResults.at(i).toObject();
+        if (!result.value("valid").toBool())
+        {
+            QJsonArray messages = result.value("parserMessage").toArray();
+            QString description = messages.isEmpty() ? QString() : messages.first().toObject().value("description").toString();
+            qCWarning(lcQtAnalytics) << QString("Hit rejected by server: %1").arg(description);
+
+            // Resending would fail the same way
+            results[i] = ETransportResult_Rejected;
+        }
+    }
+}
+
+bool CHttpTransport::isPermanentError(int httpStatusCode)
+{
+    // Client errors are caused by the payload and fail again, except timeouts and throttling
+    return (httpStatusCode >= 400) && (httpStatusCode <= 499) && (httpStatusCode != 408) && (httpStatusCode != 429);
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "qtanalytics_global.h"
+#include "analyticsmanager.h"
+#include "itransport.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QNetworkAccessManager>
+
+QTANALYTICS_NAMESPACE_BEGIN
+
+///
+/// \brief Sends hits to the Google Analytics endpoints, with the copy of the settings the dispatcher hands over.
+///
+class CHttpTransport : public ITransport
+{
+    Q_OBJECT
+
+public:
+    CHttpTransport(CAnalyticsManager* pAnalyticsManager, const CAnalyticsManager::SSettings &settings);
+    virtual ~CHttpTransport();
+
+    void setSettings(const CAnalyticsManager::SSettings &settings);
+
+    bool supportsBatch() const override;
+    void send(quint64 requestId, const QList<QByteArray> &payloads) override;
+    void warmUp() override;
+
+private slots:
+    void onReplyFinished();
+    void onEncrypted(QNetworkReply* reply);
+
+private:
+    QString getEndPoint(bool isBatch) const;
+    static void markInvalidBatchHits(QVector<ETransportResult> &results, const QByteArray &response);
+    static bool isPermanentError(int httpStatusCode);
+    void countPlainConnection();
+
+    static QString m_endPointUnsecureDebug;
+    static QString m_endPointSecureDebug;
+    static QString m_endPointUnsecure;
+    static QString m_endPointSecure;
+    static QString m_endPointUnsecureDebugBatch;
+    static QString m_endPointSecureDebugBatch;
+    static QString m_endPointUnsecureBatch;
+    static QString m_endPointSecureBatch;
+    static const qint64 m_connectionExpiry;
+
+    CAnalyticsManager* m_pAnalyticsManager;
+    CAnalyticsManager::SSettings m_settings;
+    QNetworkAccessManager* m_pNetworkAccessManager;
+
+    // Plain connections are not reported, they are assumed open until the access manager expires them
+    QElapsedTimer m_lastActivity;
+};
+
+QTANALYTICS_NAMESPACE_END
@@ -21,6 +21,7 @@
 #pragma once
 
 #include "qtanalytics_global.h"
+#include "hit.h"
 
 #include <QMap>
 
@@ -33,6 +34,12 @@ public:
     virtual ~IAnalyticsManager() {}
 
     virtual void enqueueHit(const QMap<QString, QString> &params) = 0;
+    virtual void enqueueHit(const CHit &hit) = 0;
+
+    ///
+    /// \brief Gets the share of hits to keep under the current load in per mille, 1000 when not loaded.
+    ///
+    virtual int adaptiveSampleFactor() const = 0;
 };
 
 QTANALYTICS_NAMESPACE_END
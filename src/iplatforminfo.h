@@ -22,6 +22,7 @@
 
 #include "qtanalytics_global.h"
 #include "dimensions.h"
+#include "platformsnapshot.h"
 
 #include <QObject>
 
@@ -64,6 +65,11 @@ public:
     ///
     virtual QString getUserAgent() const = 0;
 
+    ///
+    /// \brief Gets all values at once, may be called from any thread. The snapshot is replaced, never changed.
+    ///
+    virtual TPlatformSnapshotPtr getSnapshot() const = 0;
+
 signals:
     ///
     /// \brief Raised to indicate that the <see cref="getViewPortResolution"/> has changed.
@@ -74,6 +80,11 @@ signals:
     /// \brief Raised to indicate that the <see cref="getScreenResolution"/> has changed.
     ///
     void screenResolutionChanged();
+
+    ///
+    /// \brief Raised when <see cref="getSnapshot"/> returns a new snapshot.
+    ///
+    void snapshotChanged();
 };
 
 QTANALYTICS_NAMESPACE_END
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "qtanalytics_global.h"
+
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+#include <QVector>
+
+QTANALYTICS_NAMESPACE_BEGIN
+
+///
+/// \brief Outcome of a single hit of a transport request.
+///
+enum ETransportResult
+{
+    ETransportResult_Delivered,     ///< The hit has been delivered
+    ETransportResult_Rejected,      ///< The hit is invalid and fails again when it is resent
+    ETransportResult_Failed         ///< Delivery failed, the hit may be resent later
+};
+
+///
+/// \brief Delivers encoded hits on behalf of the dispatcher.
+///
+/// Transports live in the sender thread. Every call of send has to be answered by exactly
+/// one finished signal with a result for every payload, emitted after send has returned.
+///
+class ITransport : public QObject
+{
+    Q_OBJECT
+
+public:
+    virtual ~ITransport() {}
+
+    ///
+    /// \brief Gets whether several payloads may be sent with one request.
+    ///
+    virtual bool supportsBatch() const = 0;
+
+    ///
+    /// \brief Sends the encoded payloads, one per hit.
+    ///
+    virtual void send(quint64 requestId, const QList<QByteArray> &payloads) = 0;
+
+    ///
+    /// \brief Prepares the connection, so the first request does not pay for it. Does nothing by default.
+    ///
+    virtual void warmUp() {}
+
+signals:
+    ///
+    /// \brief Raised when a request has been completed, with the result of every payload in order.
+    ///
+    void finished(quint64 requestId, const QVector<ETransportResult> &results, const QString &errorString);
+};
+
+QTANALYTICS_NAMESPACE_END
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "loopbacktransport.h"
+
+QTANALYTICS_NAMESPACE_USING
+
+CLoopbackTransport::CLoopbackTransport()
+    : ITransport()
+    , Result(ETransportResult_Delivered)
+    , IsKeepingPayloads(false)
+    , m_hitCount(0)
+    , m_byteCount(0)
+    , m_requestCount(0)
+{
+}
+
+CLoopbackTransport::~CLoopbackTransport()
+{
+}
+
+bool CLoopbackTransport::supportsBatch() const
+{
+    return true;
+}
+
+void CLoopbackTransport::send(quint64 requestId, const QList<QByteArray> &payloads)
+{
+    quint64 bytes = 0;
+    for (QList<QByteArray>::const_iterator it = payloads.constBegin(), end = payloads.constEnd(); it != end; ++it)
+    {
+        bytes += it->size();
+    }
+
+    m_requestCount.fetchAndAddRelaxed(1);
+    m_hitCount.fetchAndAddRelaxed(payloads.size());
+    m_byteCount.fetchAndAddRelaxed(bytes);
+
+    if (IsKeepingPayloads)
+    {
+        QMutexLocker locker(&m_payloadsMutex);
+        m_payloads.append(payloads);
+    }
+
+    QVector<ETransportResult> results(payloads.size(), Result);
+    QMetaObject::invokeMethod(this, [this, requestId, results]() { emit finished(requestId, results, QString()); }, Qt::QueuedConnection);
+}
+
+quint64 CLoopbackTransport::hitCount() const
+{
+    return m_hitCount.loadAcquire();
+}
+
+quint64 CLoopbackTransport::byteCount() const
+{
+    return m_byteCount.loadAcquire();
+}
+
+quint64 CLoopbackTransport::requestCount() const
+{
+    return m_requestCount.loadAcquire();
+}
+
+QList<QByteArray> CLoopbackTransport::takePayloads()
+{
+    QMutexLocker locker(&m_payloadsMutex);
+    QList<QByteArray> payloads;
+    payloads.swap(m_payloads);
+
+    return payloads;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "qtanalytics_global.h"
+#include "itransport.h"
+
+#include <QAtomicInteger>
+#include <QMutex>
+
+QTANALYTICS_NAMESPACE_BEGIN
+
+///
+/// \brief Completes every request in process without any I/O, for tests and benchmarks.
+///
+/// Counters may be read from any thread. Payloads are only kept when asked for, so the
+/// transport costs next to nothing when the throughput of the pipeline is measured.
+///
+class CLoopbackTransport : public ITransport
+{
+    Q_OBJECT
+    Q_PROPERTY(quint64 hitCount READ hitCount)
+    Q_PROPERTY(quint64 byteCount READ byteCount)
+    Q_PROPERTY(quint64 requestCount READ requestCount)
+
+public:
+    CLoopbackTransport();
+    virtual ~CLoopbackTransport();
+
+    bool supportsBatch() const override;
+    void send(quint64 requestId, const QList<QByteArray> &payloads) override;
+
+    quint64 hitCount() const;
+    quint64 byteCount() const;
+    quint64 requestCount() const;
+
+    ///
+    /// \brief Takes the payloads received since the last call, requires IsKeepingPayloads.
+    ///
+    QList<QByteArray> takePayloads();
+
+    ///
+    /// \brief Gets or sets the result reported for every hit. Default is ETransportResult_Delivered.
+    ///
+    ETransportResult Result;
+
+    ///
+    /// \brief Gets or sets whether received payloads are kept for takePayloads. Default is false.
+    ///
+    bool IsKeepingPayloads;
+
+private:
+    QAtomicInteger<quint64> m_hitCount;
+    QAtomicInteger<quint64> m_byteCount;
+    QAtomicInteger<quint64> m_requestCount;
+
+    QMutex m_payloadsMutex;
+    QList<QByteArray> m_payloads;
+};
+
+QTANALYTICS_NAMESPACE_END
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "qtanalytics_global.h"
+
+#include <QAtomicPointer>
+
+QTANALYTICS_NAMESPACE_BEGIN
+
+///
+/// \brief Unbounded, lock-free multi-producer/single-consumer queue.
+///
+/// Any thread may push, which costs one allocation and one atomic exchange. Only a
+/// single consumer thread may pop. A push is visible to the consumer once it is linked,
+/// a producer preempted in between briefly hides the elements queued after it.
+///
+template <typename T>
+class CMpscQueue
+{
+public:
+    CMpscQueue()
+        : m_pTail(new SNode())
+    {
+        m_head.storeRelease(m_pTail);
+    }
+
+    ~CMpscQueue()
+    {
+        T value;
+        while (pop(value))
+        {
+        }
+
+        delete m_pTail;
+    }
+
+    ///
+    /// \brief Appends a value, may be called from any thread.
+    ///
+    void push(const T &value)
+    {
+        SNode* pNode = new SNode(value);
+        SNode* pPrevious = m_head.fetchAndStoreOrdered(pNode);
+        pPrevious->Next.storeRelease(pNode);
+    }
+
+    ///
+    /// \brief Takes the oldest value, must only be called from the consumer thread.
+    ///
+    bool pop(T &value)
+    {
+        SNode* pNext = m_pTail->Next.loadAcquire();
+        if (!pNext)
+        {
+            return false;
+        }
+
+        // The next node becomes the new stub
+        value = pNext->Value;
+        pNext->Value = T();
+
+        delete m_pTail;
+        m_pTail = pNext;
+
+        return true;
+    }
+
+    ///
+    /// \brief Returns whether the queue is empty, must only be called from the consumer thread.
+    ///
+    bool isEmpty() const
+    {
+        return m_pTail->Next.loadAcquire() == Q_NULLPTR;
+    }
+
+private:
+    Q_DISABLE_COPY(CMpscQueue)
+
+    struct SNode
+    {
+        SNode()
+            : Next(Q_NULLPTR)
+        {
+        }
+
+        SNode(const T &value)
+            : Next(Q_NULLPTR)
+            , Value(value)
+        {
+        }
+
+        QAtomicPointer<SNode> Next;
+        T Value;
+    };
+
+    QAtomicPointer<SNode> m_head;
+    SNode* m_pTail;
+};
+
+QTANALYTICS_NAMESPACE_END
@@ -20,11 +20,11 @@
 
 #include "platforminfo.h"
 
-#include <QApplication>
+#include <QCoreApplication>
 #include <QDateTime>
+#include <QEvent>
 #include <QLocale>
 #include <QRandomGenerator>
-#include <QResizeEvent>
 #include <QSettings>
 
 #ifdef Q_OS_LINUX
@@ -37,29 +37,28 @@ QString CPlatformInfo::m_keyAnonymousClientId = "AnonymousClientId";
 
 CPlatformInfo::CPlatformInfo()
     : IPlatformInfo()
-    , m_pActiveDesktop(Q_NULLPTR)
-    , m_pActiveWindow(Q_NULLPTR)
-    , m_windowInitialized(false)
+    , m_viewPortResolution()
+    , m_screenResolution()
+    , m_systemInfo(getSystemInfo())
 {
-    initializeWindow();
+    QCoreApplication* pApplication = QCoreApplication::instance();
+    if (pApplication)
+    {
+        // The user agent contains name and version of the application, which may be set later
+        connect(pApplication, &QCoreApplication::applicationNameChanged, this, &CPlatformInfo::onApplicationChanged);
+        connect(pApplication, &QCoreApplication::applicationVersionChanged, this, &CPlatformInfo::onApplicationChanged);
+        pApplication->installEventFilter(this);
+    }
+
+    updateSnapshot();
 }
 
 CPlatformInfo::~CPlatformInfo()
 {
-    // Uninstall event filters
-    if (m_pActiveWindow)
-    {
-        m_pActiveWindow->removeEventFilter(this);
-    }
-
-    if (m_pActiveDesktop)
+    if (QCoreApplication::instance())
     {
-        m_pActiveDesktop->removeEventFilter(this);
+        QCoreApplication::instance()->removeEventFilter(this);
     }
-
-    m_pActiveWindow = Q_NULLPTR;
-    m_pActiveDesktop = Q_NULLPTR;
-    m_windowInitialized = false;
 }
 
 void CPlatformInfo::setAnonymousClientId(const QString& value)
@@ -67,37 +66,6 @@ void CPlatformInfo::setAnonymousClientId(const QString& value)
     m_anonymousClientId = value;
 }
 
-void CPlatformInfo::initializeWindow()
-{
-    QScreen* pActiveDesktop = qApp->primaryScreen();
-    if (pActiveDesktop)
-    {
-        // Setup resolutions
-        setScreenResolution(pActiveDesktop->geometry());
-
-        // Store for event processing
-        m_pActiveDesktop = pActiveDesktop;
-
-        // Install event filters
-        m_pActiveDesktop->installEventFilter(this);
-    }
-
-    QWidget* pActiveWindow = qApp->activeWindow();
-    if (pActiveWindow)
-    {
-        // Setup resolutions
-        setViewPortResolution(pActiveWindow->geometry());
-
-        // Store for event processing
-        m_pActiveWindow = pActiveWindow;
-
-        // Install event filters
-        m_pActiveWindow->installEventFilter(this);
-
-        m_windowInitialized = true;
-    }
-}
-
 Dimensions CPlatformInfo::parseDimensionsUpdate(Dimensions& currentDimensions, const QRect& newSize, bool& hasChanged)
 {
     Dimensions valueDimensions;
@@ -105,58 +73,57 @@ Dimensions CPlatformInfo::parseDimensionsUpdate(Dimensions& currentDimensions, c
     {
         valueDimensions.Width = newSize.size().width();
         valueDimensions.Height = newSize.size().height();
-        if (qFuzzyCompare(currentDimensions.Height, newSize.size().height()) || qFuzzyCompare(currentDimensions.Width, newSize.size().width()))
+        if (!qFuzzyCompare(currentDimensions.Height, newSize.size().height()) || !qFuzzyCompare(currentDimensions.Width, newSize.size().width()))
         {
             hasChanged = true;
         }
     }
+    else
+    {
+        valueDimensions = currentDimensions;
+    }
 
     return valueDimensions;
 }
 
-void CPlatformInfo::setViewPortResolution(const QRect& value)
+bool CPlatformInfo::setViewPortResolution(const QRect& value)
 {
     bool hasChanged = false;
     m_viewPortResolution = parseDimensionsUpdate(m_viewPortResolution, value, hasChanged);
-    if (hasChanged)
-    {
-        emit viewPortResolutionChanged();
-    }
+
+    return hasChanged;
 }
 
-void CPlatformInfo::setScreenResolution(const QRect& value)
+bool CPlatformInfo::setScreenResolution(const QRect& value)
 {
     bool hasChanged = false;
     m_screenResolution = parseDimensionsUpdate(m_screenResolution, value, hasChanged);
-    if (hasChanged)
-    {
-        emit screenResolutionChanged();
-    }
+
+    return hasChanged;
 }
 
-void CPlatformInfo::onViewPortResolutionChanged(QResizeEvent* event)
+void CPlatformInfo::updateSnapshot()
 {
-    setScreenResolution(QRect(QPoint(0, 0), event->size()));
+    QString userLanguage = QLocale::system().name();
+    QString userAgent = QString("%1/%2 (%3; %4) QtAnalytics/1.0 (Qt/%5)").arg(QCoreApplication::applicationName()).arg(QCoreApplication::applicationVersion()).arg(m_systemInfo).arg(userLanguage).arg(QT_VERSION_STR);
+    TPlatformSnapshotPtr pSnapshot(new CPlatformSnapshot(m_screenResolution, m_viewPortResolution, getScreenColors(), userLanguage, userAgent));
+
+    QMutexLocker locker(&m_snapshotMutex);
+    m_pSnapshot = pSnapshot;
 }
 
-void CPlatformInfo::onScreenResolutionChanged(QResizeEvent* event)
+void CPlatformInfo::onApplicationChanged()
 {
-    setViewPortResolution(QRect(QPoint(0, 0), event->size()));
+    updateSnapshot();
+    emit snapshotChanged();
 }
 
 bool CPlatformInfo::eventFilter(QObject* obj, QEvent* event)
 {
-    if (event->type() == QEvent::Resize)
+    if ((event->type() == QEvent::LocaleChange) && (obj == QCoreApplication::instance()))
     {
-        QResizeEvent* resizeEvent = static_cast<QResizeEvent*>(event);
-        if (obj == m_pActiveWindow)
-        {
-            onViewPortResolutionChanged(resizeEvent);
-        }
-        else if (obj == m_pActiveDesktop)
-        {
-            onScreenResolutionChanged(resizeEvent);
-        }
+        updateSnapshot();
+        emit snapshotChanged();
 
         return false;
     }
@@ -213,10 +180,10 @@ int CPlatformInfo::getScreenColors() const
 
 QString CPlatformInfo::getUserLanguage() const
 {
-    return QLocale::system().name();
+    return getSnapshot()->getUserLanguage();
 }
 
-QString CPlatformInfo::getSystemInfo() const
+QString CPlatformInfo::getSystemInfo()
 {
     QString osString;
 
@@ -283,12 +250,11 @@ QString CPlatformInfo::getSystemInfo() const
 
 QString CPlatformInfo::getUserAgent() const
 {
-    QString locale = getUserLanguage();
-    QString system = getSystemInfo();
-
-    QString appName = qApp->applicationName();
-    QString appVersion = qApp->applicationVersion();
-    QString userAgent = QString("%1/%2 (%3; %4) QtAnalytics/1.0 (Qt/%5)").arg(appName).arg(appVersion).arg(system).arg(locale).arg(QT_VERSION_STR);
+    return getSnapshot()->getUserAgent();
+}
 
-    return userAgent;
+TPlatformSnapshotPtr CPlatformInfo::getSnapshot() const
+{
+    QMutexLocker locker(&m_snapshotMutex);
+    return m_pSnapshot;
 }
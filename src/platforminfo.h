@@ -23,13 +23,18 @@
 #include "qtanalytics_global.h"
 #include "iplatforminfo.h"
 
+#include <QMutex>
 #include <QObject>
-
-#include <QWidget>
-#include <QScreen>
+#include <QRect>
 
 QTANALYTICS_NAMESPACE_BEGIN
 
+///
+/// \brief Platform information which only needs QtCore, screen and viewport are unknown.
+///
+/// Used by headless processes. CGuiPlatformInfo of the GUI add-on extends it with the
+/// resolutions of the screen and the active window.
+///
 class CPlatformInfo: public IPlatformInfo
 {
     Q_OBJECT
@@ -45,13 +50,21 @@ public:
 
     void setAnonymousClientId(const QString &value);
 
-private:
-    void initializeWindow();
-    QString getSystemInfo() const;
+protected:
     Dimensions parseDimensionsUpdate(Dimensions &currentDimensions, const QRect &newSize, bool &hasChanged);
 
-    void setViewPortResolution(const QRect &value);
-    void setScreenResolution(const QRect &value);
+    bool setViewPortResolution(const QRect &value);
+    bool setScreenResolution(const QRect &value);
+
+    ///
+    /// \brief Replaces the snapshot with one of the current values.
+    ///
+    void updateSnapshot();
+
+    bool eventFilter(QObject *obj, QEvent *event);
+
+private:
+    static QString getSystemInfo();
 
     Dimensions m_viewPortResolution;
     Dimensions m_screenResolution;
@@ -59,16 +72,14 @@ private:
     static QString m_keyAnonymousClientId;
     mutable QString m_anonymousClientId;
 
-    QScreen *m_pActiveDesktop;
-    QWidget *m_pActiveWindow;
-    bool m_windowInitialized;
+    // Operating system part of the user agent, it does not change while running
+    QString m_systemInfo;
 
-private slots:
-    void onViewPortResolutionChanged(QResizeEvent *event);
-    void onScreenResolutionChanged(QResizeEvent *eventy);
+    mutable QMutex m_snapshotMutex;
+    TPlatformSnapshotPtr m_pSnapshot;
 
-protected:
-    bool eventFilter(QObject *obj, QEvent *event);
+private slots:
+    void onApplicationChanged();
 
     // IPlatformInfo interface
 public:
@@ -78,6 +89,7 @@ public:
     int getScreenColors() const;
     QString getUserLanguage() const;
     QString getUserAgent() const;
+    TPlatformSnapshotPtr getSnapshot() const;
 };
 
 QTANALYTICS_NAMESPACE_END
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "platformsnapshot.h"
+
+QTANALYTICS_NAMESPACE_USING
+
+CPlatformSnapshot::CPlatformSnapshot(const Dimensions &screenResolution, const Dimensions &viewPortResolution, int screenColors, const QString &userLanguage, const QString &userAgent)
+    : m_screenResolution(screenResolution)
+    , m_viewPortResolution(viewPortResolution)
+    , m_screenColors(screenColors)
+    , m_userLanguage(userLanguage)
+    , m_userAgent(userAgent)
+    , m_screenResolutionString(formatDimensions(screenResolution))
+    , m_viewPortResolutionString(formatDimensions(viewPortResolution))
+    , m_userAgentHeader(userAgent.toUtf8())
+{
+}
+
+Dimensions CPlatformSnapshot::getScreenResolution() const
+{
+    return m_screenResolution;
+}
+
+Dimensions CPlatformSnapshot::getViewPortResolution() const
+{
+    return m_viewPortResolution;
+}
+
+int CPlatformSnapshot::getScreenColors() const
+{
+    return m_screenColors;
+}
+
+QString CPlatformSnapshot::getUserLanguage() const
+{
+    return m_userLanguage;
+}
+
+QString CPlatformSnapshot::getUserAgent() const
+{
+    return m_userAgent;
+}
+
+const QString &CPlatformSnapshot::getScreenResolutionString() const
+{
+    return m_screenResolutionString;
+}
+
+const QString &CPlatformSnapshot::getViewPortResolutionString() const
+{
+    return m_viewPortResolutionString;
+}
+
+const QByteArray &CPlatformSnapshot::getUserAgentHeader() const
+{
+    return m_userAgentHeader;
+}
+
+QString CPlatformSnapshot::formatDimensions(const Dimensions &dimensions)
+{
+    if (qFuzzyCompare(dimensions.Width, 0) || qFuzzyCompare(dimensions.Height, 0))
+    {
+        return QString();
+    }
+
+    return QString("%1x%2").arg(dimensions.Width).arg(dimensions.Height);
+}
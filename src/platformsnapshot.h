@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "qtanalytics_global.h"
+#include "dimensions.h"
+
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QString>
+
+QTANALYTICS_NAMESPACE_BEGIN
+
+///
+/// \brief Immutable platform values, with the strings hits and requests need already formatted.
+///
+/// A snapshot is computed once and replaced as a whole when a value changes, so it can be
+/// shared by pointer between threads without locking.
+///
+class CPlatformSnapshot
+{
+public:
+    CPlatformSnapshot(const Dimensions &screenResolution, const Dimensions &viewPortResolution, int screenColors, const QString &userLanguage, const QString &userAgent);
+
+    Dimensions getScreenResolution() const;
+    Dimensions getViewPortResolution() const;
+    int getScreenColors() const;
+    QString getUserLanguage() const;
+    QString getUserAgent() const;
+
+    ///
+    /// \brief Gets the screen resolution as sent in the 'sr' parameter, empty when unknown.
+    ///
+    const QString &getScreenResolutionString() const;
+
+    ///
+    /// \brief Gets the viewport resolution as sent in the 'vp' parameter, empty when unknown.
+    ///
+    const QString &getViewPortResolutionString() const;
+
+    ///
+    /// \brief Gets the value of the User-Agent request header.
+    ///
+    const QByteArray &getUserAgentHeader() const;
+
+    static QString formatDimensions(const Dimensions &dimensions);
+
+private:
+    Q_DISABLE_COPY(CPlatformSnapshot)
+
+    const Dimensions m_screenResolution;
+    const Dimensions m_viewPortResolution;
+    const int m_screenColors;
+    const QString m_userLanguage;
+    const QString m_userAgent;
+
+    const QString m_screenResolutionString;
+    const QString m_viewPortResolutionString;
+    const QByteArray m_userAgentHeader;
+};
+
+typedef QSharedPointer<const CPlatformSnapshot> TPlatformSnapshotPtr;
+
+QTANALYTICS_NAMESPACE_END
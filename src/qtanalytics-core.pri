@@ -0,0 +1,75 @@
+# Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+#
+# This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+# documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+# to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+# the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO 
+# THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+# CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+# IN THE SOFTWARE.
+
+INCLUDEPATH += $$PWD
+QT += network
+CONFIG += c++11
+
+HEADERS += \
+    $$PWD/qtanalytics_global.h \
+    $$PWD/crashrecorder.h \
+    $$PWD/dimensions.h \
+    $$PWD/eventcoalescer.h \
+    $$PWD/filetransport.h \
+    $$PWD/analyticslogging.h \
+    $$PWD/analyticsmanager.h \
+    $$PWD/analyticsmetrics.h \
+    $$PWD/hit.h \
+    $$PWD/hitcompletion.h \
+    $$PWD/hitdispatcher.h \
+    $$PWD/hitjournal.h \
+    $$PWD/hitparameters.h \
+    $$PWD/hitqueue.h \
+    $$PWD/hitschema.h \
+    $$PWD/httptransport.h \
+    $$PWD/mpscqueue.h \
+    $$PWD/ianalyticsmanager.h \
+    $$PWD/hitbuilder.h \
+    $$PWD/iplatforminfo.h \
+    $$PWD/itransport.h \
+    $$PWD/loopbacktransport.h \
+    $$PWD/platforminfo.h \
+    $$PWD/platformsnapshot.h \
+    $$PWD/sharedhitring.h \
+    $$PWD/timingaggregator.h \
+    $$PWD/timinghistogram.h \
+    $$PWD/tokenbucket.h \
+    $$PWD/tracker.h
+
+SOURCES += \
+    $$PWD/analyticslogging.cpp \
+    $$PWD/analyticsmanager.cpp \
+    $$PWD/analyticsmetrics.cpp \
+    $$PWD/crashrecorder.cpp \
+    $$PWD/eventcoalescer.cpp \
+    $$PWD/filetransport.cpp \
+    $$PWD/hitbuilder.cpp \
+    $$PWD/hitdispatcher.cpp \
+    $$PWD/hitjournal.cpp \
+    $$PWD/hitparameters.cpp \
+    $$PWD/hitqueue.cpp \
+    $$PWD/hitschema.cpp \
+    $$PWD/httptransport.cpp \
+    $$PWD/loopbacktransport.cpp \
+    $$PWD/platforminfo.cpp \
+    $$PWD/platformsnapshot.cpp \
+    $$PWD/sharedhitring.cpp \
+    $$PWD/timingaggregator.cpp \
+    $$PWD/timinghistogram.cpp \
+    $$PWD/tokenbucket.cpp \
+    $$PWD/tracker.cpp
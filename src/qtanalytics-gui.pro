@@ -0,0 +1,42 @@
+# Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+#
+# This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+# documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+# to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+# the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+# THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+# CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+
+
+DEFINES += QTANALYTICS_LIBRARY
+TARGET = QtAnalyticsGui
+TEMPLATE = lib
+
+CONFIG += debug_and_release
+CONFIG(debug, debug|release) {
+    mac: TARGET = $$join(TARGET,,,_debug)
+    win32: TARGET = $$join(TARGET,,,d)
+}
+
+# The add-on links the core library built by qtanalytics-core.pro instead of compiling the core again
+QT += network
+CORE_TARGET = QtAnalyticsCore
+CONFIG(debug, debug|release) {
+    mac: CORE_TARGET = $$join(CORE_TARGET,,,_debug)
+    win32: CORE_TARGET = $$join(CORE_TARGET,,,d)
+    win32: LIBS += -L$$OUT_PWD/debug
+} else {
+    win32: LIBS += -L$$OUT_PWD/release
+}
+LIBS += -L$$OUT_PWD -l$$CORE_TARGET
+
+include($$PWD/qtanalytics-gui.pri)
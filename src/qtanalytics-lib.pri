@@ -16,23 +16,6 @@
 # CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
 # IN THE SOFTWARE.
 
-INCLUDEPATH += $$PWD
-QT += network gui widgets
-
-HEADERS += \
-    $$PWD/qtanalytics_global.h \
-    $$PWD/dimensions.h \
-    $$PWD/analyticsmanager.h \
-    $$PWD/hit.h \
-    $$PWD/ianalyticsmanager.h \
-    $$PWD/hitbuilder.h \
-    $$PWD/iplatforminfo.h \
-    $$PWD/platforminfo.h \
-    $$PWD/tracker.h
-
-SOURCES += \
-    $$PWD/analyticsmanager.cpp \
-    $$PWD/hitbuilder.cpp \
-    $$PWD/platforminfo.cpp \
-    $$PWD/tracker.cpp
-
+# Core and GUI add-on, headless processes include qtanalytics-core.pri instead
+include($$PWD/qtanalytics-core.pri)
+include($$PWD/qtanalytics-gui.pri)
@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "sharedhitring.h"
+#include "analyticslogging.h"
+
+#include <QAtomicInteger>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QRandomGenerator>
+
+#include <cstring>
+
+QTANALYTICS_NAMESPACE_USING
+
+const quint32 CSharedHitRing::m_magic = 0x52415451;       // 'QTAR'
+const quint32 CSharedHitRing::m_version = 2;
+const int CSharedHitRing::m_dataOffset = 64;
+const int CSharedHitRing::m_stuckTimeout = 5000;
+
+const int CSharedHitRing::DefaultCapacity;
+const int CSharedHitRing::LeaseTimeout;
+
+// Both structures live in shared memory, so they only hold plain data and basic atomics
+struct CSharedHitRing::SRingHeader
+{
+    quint32 Magic;
+    quint32 Version;
+    quint32 Capacity;
+    quint32 Reserved;
+    QBasicAtomicInteger<quint64> WritePosition;
+    QBasicAtomicInteger<quint64> ReadPosition;
+    QBasicAtomicInteger<quint64> LeaderId;
+    QBasicAtomicInteger<qint64> Heartbeat;
+};
+
+struct CSharedHitRing::SRecordHeader
+{
+    QBasicAtomicInteger<quint32> Tag;
+    quint32 Size;
+    qint64 TimeStamp;
+};
+
+namespace
+{
+    // Records which fill up the end of the ring have this flag in their size, the lane of a hit is
+    // kept in the bits above the payload size
+    const quint32 s_paddingFlag = 0x80000000;
+    const int s_priorityShift = 24;
+    const quint32 s_sizeMask = (1u << s_priorityShift) - 1;
+}
+
+CSharedHitRing::CSharedHitRing()
+    : m_capacity(0)
+    , m_leaderId(0)
+    , m_stuckPosition(0)
+{
+    // Unique among all processes attached to the ring, never 0
+    m_leaderId = (static_cast<quint64>(QCoreApplication::applicationPid()) << 32) | (QRandomGenerator::global()->generate() | 1);
+}
+
+CSharedHitRing::~CSharedHitRing()
+{
+    detach();
+}
+
+bool CSharedHitRing::attach(const QString &key, int capacity)
+{
+    detach();
+
+    quint64 alignedCapacity = static_cast<quint64>(qMax(capacity, 4096)) & ~static_cast<quint64>(7);
+    m_memory.setKey(key);
+
+    bool isCreated = m_memory.create(m_dataOffset + static_cast<int>(alignedCapacity));
+    if (!isCreated && ((m_memory.error() != QSharedMemory::AlreadyExists) || !m_memory.attach()))
+    {
+        qCWarning(lcQtAnalytics) << "Cannot attach to shared queue" << key << m_memory.errorString();
+        return false;
+    }
+
+    // Initialization is the only step which takes the lock, a creator may have died half way through it.
+    // Whoever gets the lock first initializes, even when another process created the memory: a new
+    // segment is zeroed, so a missing magic is the only reliable sign that nobody did it yet.
+    m_memory.lock();
+    SRingHeader* pHeader = header();
+    if ((pHeader->Magic != m_magic) || (pHeader->Version != m_version))
+    {
+        memset(m_memory.data(), 0, static_cast<size_t>(m_memory.size()));
+        pHeader->Capacity = static_cast<quint32>(static_cast<quint64>(m_memory.size() - m_dataOffset) & ~static_cast<quint64>(7));
+        pHeader->Version = m_version;
+        pHeader->Magic = m_magic;
+    }
+
+    m_capacity = pHeader->Capacity;
+    m_memory.unlock();
+
+    if (m_memory.size() < m_dataOffset + static_cast<int>(m_capacity))
+    {
+        qCWarning(lcQtAnalytics) << "Shared queue" << key << "is smaller than its header claims";
+        detach();
+        return false;
+    }
+
+    m_stuckPosition = 0;
+    m_stuckTimer.invalidate();
+
+    return true;
+}
+
+void CSharedHitRing::detach()
+{
+    if (!m_memory.isAttached())
+    {
+        return;
+    }
+
+    releaseLeadership();
+    m_memory.detach();
+    m_capacity = 0;
+}
+
+bool CSharedHitRing::isAttached() const
+{
+    return m_memory.isAttached();
+}
+
+QString CSharedHitRing::key() const
+{
+    return m_memory.key();
+}
+
+bool CSharedHitRing::push(const CHit &hit)
+{
+    const QByteArray &payload = hit.getPayload();
+    quint64 size = recordSize(payload.size());
+    if (!isAttached() || (size > m_capacity / 4) || (static_cast<quint32>(payload.size()) > s_sizeMask))
+    {
+        return false;
+    }
+
+    // Reserve the record, a record which does not fit before the end of the ring gets padding in front
+    SRingHeader* pHeader = header();
+    quint64 position;
+    quint64 padding;
+    do
+    {
+        position = pHeader->WritePosition.loadAcquire();
+        quint64 offset = position % m_capacity;
+        padding = (m_capacity - offset < size) ? (m_capacity - offset) : 0;
+
+        if (position + padding + size - pHeader->ReadPosition.loadAcquire() > m_capacity)
+        {
+            return false;
+        }
+    }
+    while (!pHeader->WritePosition.testAndSetOrdered(position, position + padding + size));
+
+    if (padding > 0)
+    {
+        SRecordHeader* pPadding = recordAt(position);
+        pPadding->Size = s_paddingFlag | static_cast<quint32>(padding);
+        pPadding->Tag.storeRelease(tagOf(position));
+        position += padding;
+    }
+
+    SRecordHeader* pRecord = recordAt(position);
+    pRecord->Size = (static_cast<quint32>(hit.getPriority()) << s_priorityShift) | static_cast<quint32>(payload.size());
+    pRecord->TimeStamp = hit.getTimeStamp().toMSecsSinceEpoch();
+    memcpy(reinterpret_cast<char*>(pRecord) + sizeof(SRecordHeader), payload.constData(), static_cast<size_t>(payload.size()));
+
+    // Publish the record, the consumer reads nothing of it before the tag matches
+    pRecord->Tag.storeRelease(tagOf(position));
+
+    return true;
+}
+
+int CSharedHitRing::pop(QList<CHit> &hits, int maxHits)
+{
+    if (!isAttached())
+    {
+        return 0;
+    }
+
+    SRingHeader* pHeader = header();
+    quint64 start = pHeader->ReadPosition.loadAcquire();
+    quint64 end = pHeader->WritePosition.loadAcquire();
+    quint64 position = start;
+
+    QList<CHit> takenHits;
+    while ((position < end) && (takenHits.size() < maxHits))
+    {
+        SRecordHeader* pRecord = recordAt(position);
+        if (pRecord->Tag.loadAcquire() != tagOf(position))
+        {
+            // A producer is still writing, or died after its reservation and never will
+            if (!m_stuckTimer.isValid() || (m_stuckPosition != position))
+            {
+                m_stuckPosition = position;
+                m_stuckTimer.start();
+            }
+            else if (m_stuckTimer.hasExpired(m_stuckTimeout) && takenHits.isEmpty())
+            {
+                qCWarning(lcQtAnalytics) << QString("Skipping %1 bytes of shared queue, a producer did not finish its record").arg(end - position);
+                position = end;
+            }
+
+            break;
+        }
+
+        if (pRecord->Size & s_paddingFlag)
+        {
+            position += pRecord->Size & ~s_paddingFlag;
+            continue;
+        }
+
+        int payloadSize = static_cast<int>(pRecord->Size & s_sizeMask);
+        QByteArray payload(reinterpret_cast<const char*>(pRecord) + sizeof(SRecordHeader), payloadSize);
+        CHit hit(payload, QDateTime::fromMSecsSinceEpoch(pRecord->TimeStamp));
+        hit.setPriority(static_cast<EHitPriority>(pRecord->Size >> s_priorityShift));
+        takenHits.append(hit);
+        position += recordSize(payloadSize);
+    }
+
+    // A leader which has been replaced without noticing must not send the same hits again
+    if ((position == start) || !pHeader->ReadPosition.testAndSetOrdered(start, position))
+    {
+        return 0;
+    }
+
+    hits.append(takenHits);
+
+    return takenHits.size();
+}
+
+bool CSharedHitRing::tryAcquireLeadership()
+{
+    if (!isAttached())
+    {
+        return false;
+    }
+
+    SRingHeader* pHeader = header();
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    quint64 leaderId = pHeader->LeaderId.loadAcquire();
+    if (leaderId == m_leaderId)
+    {
+        return true;
+    }
+
+    if ((leaderId != 0) && (now - pHeader->Heartbeat.loadAcquire() < LeaseTimeout))
+    {
+        return false;
+    }
+
+    if (!pHeader->LeaderId.testAndSetOrdered(leaderId, m_leaderId))
+    {
+        return false;
+    }
+
+    pHeader->Heartbeat.storeRelease(now);
+
+    return true;
+}
+
+bool CSharedHitRing::renewLeadership()
+{
+    if (!isLeader())
+    {
+        return false;
+    }
+
+    header()->Heartbeat.storeRelease(QDateTime::currentMSecsSinceEpoch());
+
+    return true;
+}
+
+void CSharedHitRing::releaseLeadership()
+{
+    if (isAttached())
+    {
+        header()->LeaderId.testAndSetOrdered(m_leaderId, 0);
+    }
+}
+
+bool CSharedHitRing::isLeader() const
+{
+    return isAttached() && (header()->LeaderId.loadAcquire() == m_leaderId);
+}
+
+CSharedHitRing::SRingHeader* CSharedHitRing::header() const
+{
+    return reinterpret_cast<SRingHeader*>(const_cast<void*>(m_memory.constData()));
+}
+
+CSharedHitRing::SRecordHeader* CSharedHitRing::recordAt(quint64 position) const
+{
+    char* pData = reinterpret_cast<char*>(const_cast<void*>(m_memory.constData())) + m_dataOffset;
+
+    return reinterpret_cast<SRecordHeader*>(pData + (position % m_capacity));
+}
+
+quint32 CSharedHitRing::tagOf(quint64 position)
+{
+    // Differs between laps over the same offset, and from the zeroed memory of a new ring
+    return static_cast<quint32>(position / 8) + 1;
+}
+
+quint64 CSharedHitRing::recordSize(int payloadSize)
+{
+    return (sizeof(SRecordHeader) + static_cast<quint64>(payloadSize) + 7) & ~static_cast<quint64>(7);
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "qtanalytics_global.h"
+#include "hit.h"
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QSharedMemory>
+#include <QString>
+
+QTANALYTICS_NAMESPACE_BEGIN
+
+///
+/// \brief Lock-free ring buffer of encoded hits in shared memory, written by several processes
+///        and drained by one elected uploader.
+///
+/// Producers reserve space with a compare-and-swap on the write position, copy the hit and
+/// publish it by storing a tag derived from its position, so no lock is taken per hit and a
+/// record of a previous lap is never mistaken for a new one. The leader copies published
+/// records and claims them with a compare-and-swap on the read position.
+///
+/// The leader holds a lease which it renews with a heartbeat. When the heartbeat is older
+/// than the lease timeout, for example because the leading process has exited, any other
+/// process may take over.
+///
+class CSharedHitRing
+{
+public:
+    ///
+    /// \brief Default size of the record area in bytes.
+    ///
+    static const int DefaultCapacity = 1024 * 1024;
+
+    ///
+    /// \brief Time in milliseconds after which the lease of a silent leader expires.
+    ///
+    static const int LeaseTimeout = 3000;
+
+    CSharedHitRing();
+    ~CSharedHitRing();
+
+    ///
+    /// \brief Attaches to the ring with the given key, the first process creates and initializes it.
+    ///
+    bool attach(const QString &key, int capacity = DefaultCapacity);
+    void detach();
+
+    bool isAttached() const;
+    QString key() const;
+
+    ///
+    /// \brief Appends the payload and timestamp of a hit, may be called from any thread and process.
+    ///        Returns false when the ring is full.
+    ///
+    bool push(const CHit &hit);
+
+    ///
+    /// \brief Takes up to maxHits published hits, must only be called by the leader.
+    ///
+    int pop(QList<CHit> &hits, int maxHits);
+
+    ///
+    /// \brief Becomes the leader, if there is none or its lease has expired.
+    ///
+    bool tryAcquireLeadership();
+
+    ///
+    /// \brief Renews the lease, returns false when another process has taken over.
+    ///
+    bool renewLeadership();
+
+    void releaseLeadership();
+    bool isLeader() const;
+
+private:
+    Q_DISABLE_COPY(CSharedHitRing)
+
+    struct SRingHeader;
+    struct SRecordHeader;
+
+    SRingHeader* header() const;
+    SRecordHeader* recordAt(quint64 position) const;
+
+    static quint32 tagOf(quint64 position);
+    static quint64 recordSize(int payloadSize);
+
+    static const quint32 m_magic;
+    static const quint32 m_version;
+    static const int m_dataOffset;
+    static const int m_stuckTimeout;
+
+    QSharedMemory m_memory;
+    quint64 m_capacity;
+    quint64 m_leaderId;
+
+    // Position of an unpublished record the leader is waiting for
+    quint64 m_stuckPosition;
+    QElapsedTimer m_stuckTimer;
+};
+
+QTANALYTICS_NAMESPACE_END
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "timingaggregator.h"
+#include "hitbuilder.h"
+#include "tracker.h"
+
+QTANALYTICS_NAMESPACE_USING
+
+CTimingAggregator::CTimingAggregator(CTracker* pTracker, QObject* pParent)
+    : QObject(pParent)
+    , CountMetric(0)
+    , P50Metric(0)
+    , P90Metric(0)
+    , P99Metric(0)
+    , m_pTracker(pTracker)
+    , m_pFlushTimer(new QTimer(this))
+{
+    m_pFlushTimer->setInterval(60 * 1000);
+    connect(m_pFlushTimer, &QTimer::timeout, this, &CTimingAggregator::flush);
+    m_pFlushTimer->start();
+
+    // The tracker sends the summaries when the manager flushes
+    if (pTracker)
+    {
+        pTracker->addTimingAggregator(this);
+    }
+}
+
+CTimingAggregator::~CTimingAggregator()
+{
+    flush();
+
+    // Histograms are owned here, the thread caches only point to them
+    QMutexLocker locker(&m_seriesMutex);
+    qDeleteAll(m_series);
+    m_series.clear();
+}
+
+void CTimingAggregator::record(const QString &category, const QString &variable, quint64 time, const QString &label)
+{
+    STimingKey key;
+    key.Category = category;
+    key.Variable = variable;
+    key.Label = label;
+
+    threadHistogram(key)->record(time);
+}
+
+int CTimingAggregator::flushInterval() const
+{
+    return m_pFlushTimer->interval();
+}
+
+void CTimingAggregator::setFlushInterval(int value)
+{
+    m_pFlushTimer->setInterval(value);
+}
+
+CTimingHistogram* CTimingAggregator::threadHistogram(const STimingKey &key)
+{
+    if (!m_threadSeries.hasLocalData())
+    {
+        m_threadSeries.setLocalData(new TThreadSeries());
+    }
+
+    TThreadSeries* pThreadSeries = m_threadSeries.localData();
+    TThreadSeries::const_iterator it = pThreadSeries->constFind(key);
+    if (it != pThreadSeries->constEnd())
+    {
+        return it.value();
+    }
+
+    // First value of the series in this thread
+    SSeries* pSeries = new SSeries();
+    pSeries->Key = key;
+
+    QMutexLocker locker(&m_seriesMutex);
+    m_series.append(pSeries);
+    locker.unlock();
+
+    pThreadSeries->insert(key, &pSeries->Histogram);
+    return &pSeries->Histogram;
+}
+
+void CTimingAggregator::flush()
+{
+    CTracker* pTracker = m_pTracker.data();
+    if (!pTracker)
+    {
+        return;
+    }
+
+    // Merge the histograms of all threads per series
+    QHash<STimingKey, QVector<quint64>> merged;
+
+    QMutexLocker locker(&m_seriesMutex);
+    for (QList<SSeries*>::const_iterator it = m_series.constBegin(), end = m_series.constEnd(); it != end; ++it)
+    {
+        (*it)->Histogram.takeInto(merged[(*it)->Key]);
+    }
+    locker.unlock();
+
+    for (QHash<STimingKey, QVector<quint64>>::const_iterator it = merged.constBegin(), end = merged.constEnd(); it != end; ++it)
+    {
+        const QVector<quint64> &counts = it.value();
+
+        quint64 totalCount = 0;
+        for (int i = 0; i < counts.size(); i++)
+        {
+            totalCount += counts.at(i);
+        }
+
+        if (totalCount == 0)
+        {
+            continue;
+        }
+
+        // The median stands for the series as user timing
+        const STimingKey &key = it.key();
+        quint64 median = CTimingHistogram::percentile(counts, totalCount, 50.0);
+        CHitBuilder builder = CHitBuilder::createTiming(key.Category, key.Variable, median, key.Label);
+
+        // createTiming leaves out a time of 0, but timing hits are invalid without it
+        if (median == 0) builder.setValue("utt", "0");
+
+        if (CountMetric > 0) builder.setCustomMetric(CountMetric, static_cast<long long>(totalCount));
+        if (P50Metric > 0) builder.setCustomMetric(P50Metric, static_cast<long long>(median));
+        if (P90Metric > 0) builder.setCustomMetric(P90Metric, static_cast<long long>(CTimingHistogram::percentile(counts, totalCount, 90.0)));
+        if (P99Metric > 0) builder.setCustomMetric(P99Metric, static_cast<long long>(CTimingHistogram::percentile(counts, totalCount, 99.0)));
+
+        pTracker->send(std::move(builder).build());
+    }
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "qtanalytics_global.h"
+#include "timinghistogram.h"
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QThreadStorage>
+#include <QTimer>
+
+QTANALYTICS_NAMESPACE_BEGIN
+
+class CTracker;
+
+///
+/// \brief Series of timing values, identified by category, variable and label.
+///
+struct STimingKey
+{
+    QString Category;
+    QString Variable;
+    QString Label;
+
+    bool operator==(const STimingKey &other) const
+    {
+        return (Category == other.Category) && (Variable == other.Variable) && (Label == other.Label);
+    }
+};
+
+inline uint qHash(const STimingKey &key, uint seed = 0)
+{
+    return qHash(key.Category, seed) ^ qHash(key.Variable, seed + 1) ^ qHash(key.Label, seed + 2);
+}
+
+///
+/// \brief Aggregates timing values on the device and sends summaries instead of single hits.
+///
+/// Values are recorded into histograms owned by the recording thread, so recording does
+/// not take a lock once a thread has seen a series. On every flush the histograms of all
+/// threads are merged and one timing hit per series is sent through the tracker. The hit
+/// carries the median as time and, when indices are set, the count and percentiles as
+/// custom metrics.
+///
+class CTimingAggregator : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int flushInterval READ flushInterval WRITE setFlushInterval)
+    Q_PROPERTY(int countMetric MEMBER CountMetric)
+    Q_PROPERTY(int p50Metric MEMBER P50Metric)
+    Q_PROPERTY(int p90Metric MEMBER P90Metric)
+    Q_PROPERTY(int p99Metric MEMBER P99Metric)
+
+public:
+    CTimingAggregator(CTracker* pTracker, QObject* pParent = Q_NULLPTR);
+    virtual ~CTimingAggregator();
+
+    ///
+    /// \brief Records a timing value in milliseconds, may be called from any thread.
+    ///
+    void record(const QString &category, const QString &variable, quint64 time, const QString &label = QString());
+
+    ///
+    /// \brief Gets or sets the interval in milliseconds in which summaries are sent. Default is 60000.
+    ///
+    int flushInterval() const;
+    void setFlushInterval(int value);
+
+    ///
+    /// \brief Gets or sets the custom metric index of the number of values, 0 to not send it.
+    ///
+    int CountMetric;
+
+    ///
+    /// \brief Gets or sets the custom metric index of the median, 0 to not send it.
+    ///
+    int P50Metric;
+
+    ///
+    /// \brief Gets or sets the custom metric index of the 90th percentile, 0 to not send it.
+    ///
+    int P90Metric;
+
+    ///
+    /// \brief Gets or sets the custom metric index of the 99th percentile, 0 to not send it.
+    ///
+    int P99Metric;
+
+public slots:
+    ///
+    /// \brief Sends a summary of every series with values since the last flush.
+    ///
+    void flush();
+
+private:
+    struct SSeries
+    {
+        STimingKey Key;
+        CTimingHistogram Histogram;
+    };
+
+    typedef QHash<STimingKey, CTimingHistogram*> TThreadSeries;
+
+    CTimingHistogram* threadHistogram(const STimingKey &key);
+
+    // The aggregator may outlive the tracker, summaries of a destroyed tracker are discarded
+    QPointer<CTracker> m_pTracker;
+    QTimer* m_pFlushTimer;
+
+    // Every thread looks up its own histograms, the list is only locked to add or flush them
+    QThreadStorage<TThreadSeries*> m_threadSeries;
+    QMutex m_seriesMutex;
+    QList<SSeries*> m_series;
+};
+
+QTANALYTICS_NAMESPACE_END
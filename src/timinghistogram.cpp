@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "timinghistogram.h"
+
+QTANALYTICS_NAMESPACE_USING
+
+const int CTimingHistogram::BucketCount;
+
+CTimingHistogram::CTimingHistogram()
+{
+}
+
+void CTimingHistogram::record(quint64 value)
+{
+    m_buckets[bucketOf(value)].fetchAndAddRelaxed(1);
+}
+
+void CTimingHistogram::takeInto(QVector<quint64> &counts)
+{
+    if (counts.size() < BucketCount)
+    {
+        counts.resize(BucketCount);
+    }
+
+    for (int i = 0; i < BucketCount; i++)
+    {
+        counts[i] += m_buckets[i].fetchAndStoreRelaxed(0);
+    }
+}
+
+void CTimingHistogram::copyInto(QVector<quint64> &counts) const
+{
+    if (counts.size() < BucketCount)
+    {
+        counts.resize(BucketCount);
+    }
+
+    for (int i = 0; i < BucketCount; i++)
+    {
+        counts[i] += m_buckets[i].loadAcquire();
+    }
+}
+
+quint64 CTimingHistogram::percentile(const QVector<quint64> &counts, quint64 totalCount, double percent)
+{
+    if (totalCount == 0)
+    {
+        return 0;
+    }
+
+    // Rank of the value, rounded up so the 100th percentile is the largest value
+    quint64 rank = static_cast<quint64>((percent / 100.0) * totalCount + 0.5);
+    rank = qBound<quint64>(1, rank, totalCount);
+
+    quint64 seen = 0;
+    for (int i = 0; i < counts.size(); i++)
+    {
+        seen += counts.at(i);
+        if (seen >= rank)
+        {
+            return bucketValue(i);
+        }
+    }
+
+    return bucketValue(counts.size() - 1);
+}
+
+int CTimingHistogram::bucketOf(quint64 value)
+{
+    if (value < 16)
+    {
+        return static_cast<int>(value);
+    }
+
+    int exponent = 63;
+    while (!(value & (Q_UINT64_C(1) << exponent)))
+    {
+        exponent--;
+    }
+
+    if (exponent >= 40)
+    {
+        return BucketCount - 1;
+    }
+
+    int subBucket = static_cast<int>((value >> (exponent - 4)) & 15);
+    return ((exponent - 3) * 16) + subBucket;
+}
+
+quint64 CTimingHistogram::bucketValue(int bucket)
+{
+    if (bucket < 16)
+    {
+        return static_cast<quint64>(bucket);
+    }
+
+    // Middle of the range covered by the bucket
+    int exponent = (bucket / 16) + 3;
+    quint64 width = Q_UINT64_C(1) << (exponent - 4);
+    quint64 lower = static_cast<quint64>(16 + (bucket % 16)) << (exponent - 4);
+
+    return lower + (width / 2);
+}
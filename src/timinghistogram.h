@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "qtanalytics_global.h"
+
+#include <QAtomicInteger>
+#include <QVector>
+
+QTANALYTICS_NAMESPACE_BEGIN
+
+///
+/// \brief Histogram of timing values with logarithmic buckets and atomic counters.
+///
+/// Values below 16 get a bucket of their own, above that every power of two is split
+/// into 16 buckets, which bounds the relative error of a percentile to about 3%. All
+/// histograms share the same layout, so they are merged by adding their bucket counts.
+///
+class CTimingHistogram
+{
+public:
+    CTimingHistogram();
+
+    ///
+    /// \brief Counts the value, lock-free and may be called from any thread.
+    ///
+    void record(quint64 value);
+
+    ///
+    /// \brief Adds the bucket counts to the given ones and resets this histogram.
+    ///
+    void takeInto(QVector<quint64> &counts);
+
+    ///
+    /// \brief Adds the bucket counts to the given ones, without resetting this histogram.
+    ///
+    void copyInto(QVector<quint64> &counts) const;
+
+    ///
+    /// \brief Gets the value of the given percentile (0 to 100) from merged bucket counts.
+    ///
+    static quint64 percentile(const QVector<quint64> &counts, quint64 totalCount, double percent);
+
+    static int bucketOf(quint64 value);
+    static quint64 bucketValue(int bucket);
+
+    // 16 linear buckets, then 16 buckets for every power of two from 2^4 up to 2^40
+    static const int BucketCount = 16 + 16 * 36;
+
+private:
+    Q_DISABLE_COPY(CTimingHistogram)
+
+    QAtomicInteger<quint32> m_buckets[BucketCount];
+};
+
+QTANALYTICS_NAMESPACE_END
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "tokenbucket.h"
+
+#include <QtMath>
+
+#include <climits>
+
+QTANALYTICS_NAMESPACE_USING
+
+CTokenBucket::CTokenBucket(double burst, double refillRate)
+    : m_lastRefill(0)
+    , m_tokens(qMax(burst, 1.0))
+    , m_burst(qMax(burst, 1.0))
+    , m_refillRate(refillRate)
+{
+    m_clock.start();
+}
+
+void CTokenBucket::setRate(double burst, double refillRate)
+{
+    // A bucket which cannot hold a whole token would hold back every hit forever
+    burst = qMax(burst, 1.0);
+
+    QMutexLocker locker(&m_mutex);
+    if (qFuzzyCompare(burst, m_burst) && qFuzzyCompare(refillRate, m_refillRate))
+    {
+        return;
+    }
+
+    refill();
+    m_burst = burst;
+    m_refillRate = refillRate;
+    m_tokens = qMin(m_tokens, m_burst);
+}
+
+bool CTokenBucket::isLimited()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_refillRate > 0.0;
+}
+
+bool CTokenBucket::tryTake(int tokens)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_refillRate <= 0.0)
+    {
+        return true;
+    }
+
+    refill();
+    if (m_tokens < tokens)
+    {
+        return false;
+    }
+
+    m_tokens -= tokens;
+    return true;
+}
+
+int CTokenBucket::available()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_refillRate <= 0.0)
+    {
+        return INT_MAX;
+    }
+
+    refill();
+    return static_cast<int>(m_tokens);
+}
+
+int CTokenBucket::waitTime(int tokens)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_refillRate <= 0.0)
+    {
+        return 0;
+    }
+
+    refill();
+    if (m_tokens >= tokens)
+    {
+        return 0;
+    }
+
+    return static_cast<int>(qCeil(((tokens - m_tokens) / m_refillRate) * 1000.0));
+}
+
+void CTokenBucket::refill()
+{
+    qint64 now = m_clock.elapsed();
+    m_tokens = qMin(m_burst, m_tokens + ((now - m_lastRefill) * m_refillRate / 1000.0));
+    m_lastRefill = now;
+}
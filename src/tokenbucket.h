@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "qtanalytics_global.h"
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QObject>
+
+QTANALYTICS_NAMESPACE_BEGIN
+
+///
+/// \brief Token bucket which limits the rate of hits, may be used from any thread.
+///
+/// The bucket holds up to burst tokens and refills continuously at the given rate per
+/// second. Every hit takes one token. A refill rate of 0 disables the limit, a burst below 1
+/// is raised to 1.
+///
+class CTokenBucket
+{
+    Q_GADGET
+
+public:
+    ///
+    /// \brief What happens to hits over the limit.
+    ///
+    enum EPolicy
+    {
+        EPolicy_Shape,
+        EPolicy_Shed
+    };
+    Q_ENUM(EPolicy)
+
+    CTokenBucket(double burst, double refillRate);
+
+    ///
+    /// \brief Changes burst and refill rate, the tokens already in the bucket are kept up to the new burst.
+    ///
+    void setRate(double burst, double refillRate);
+
+    bool isLimited();
+
+    ///
+    /// \brief Takes the given number of tokens if they are available.
+    ///
+    bool tryTake(int tokens = 1);
+
+    ///
+    /// \brief Gets the number of whole tokens available.
+    ///
+    int available();
+
+    ///
+    /// \brief Gets the time in milliseconds until the given number of tokens is available.
+    ///
+    int waitTime(int tokens = 1);
+
+private:
+    Q_DISABLE_COPY(CTokenBucket)
+
+    void refill();
+
+    QMutex m_mutex;
+    QElapsedTimer m_clock;
+    qint64 m_lastRefill;
+    double m_tokens;
+    double m_burst;
+    double m_refillRate;
+};
+
+QTANALYTICS_NAMESPACE_END
@@ -20,27 +20,67 @@
 
 #include "tracker.h"
 #include "analyticsmanager.h"
+#include "crashrecorder.h"
+#include "timingaggregator.h"
+
+#include <climits>
 
 QTANALYTICS_NAMESPACE_USING
 
+const int CTracker::m_maxShapedHits = 1000;
+
+static_assert(EHitParameter_Custom < 64, "Common parameter ids must fit into the mask");
+
 CTracker::CTracker(QString& propertyId, IPlatformInfo* pPlatformInfo, IAnalyticsManager* pAnalyticsManager)
     : AnonymizeIP(false)
+    , ScreenResolution()
+    , ViewportSize()
+    , ScreenColors(0)
+    , SampleRate(100.0)
+    , AdaptiveSampling(false)
+    , RateLimitBurst(20)
+    , RateLimitRefill(2.0)
+    , RateLimitPolicy(CTokenBucket::EPolicy_Shape)
     , m_pAnalyticsManager(pAnalyticsManager)
     , m_pPlatformInfo(pPlatformInfo)
     , m_propertyId(propertyId)
+    , m_pEventCoalescer(Q_NULLPTR)
+    , m_rateLimiter(20, 2.0)
+    , m_pShapeTimer(new QTimer(this))
+    , m_isShapePending(0)
+    , m_delayedHits(0)
+    , m_shedHits(0)
+    , m_sampleBucket(0)
+    , m_commonIds(0)
+    , m_isCommonPayloadDirty(true)
+    , m_isCrashRecording(false)
 {
+    m_pEventCoalescer = new CEventCoalescer([this](const CHitParameters &params, const QDateTime &timeStamp) { enqueueLimited(params, timeStamp); }, this);
+
+    m_pShapeTimer->setSingleShot(true);
+    connect(m_pShapeTimer, &QTimer::timeout, this, &CTracker::onSendShapedHits);
+
     if (pPlatformInfo)
     {
         ClientId = pPlatformInfo->getAnonymousClientId();
-        ScreenColors = pPlatformInfo->getScreenColors();
-        ScreenResolution = pPlatformInfo->getScreenResolution();
-        ViewportSize = pPlatformInfo->getViewPortResolution();
 
-        connect(pPlatformInfo, &IPlatformInfo::screenResolutionChanged, this, &CTracker::onScreenResolutionChanged);
-        connect(pPlatformInfo, &IPlatformInfo::viewPortResolutionChanged, this, &CTracker::onViewPortResolutionChanged);
+        m_pPlatformSnapshot = pPlatformInfo->getSnapshot();
+        ScreenColors = m_pPlatformSnapshot->getScreenColors();
+        ScreenResolution = m_pPlatformSnapshot->getScreenResolution();
+        ViewportSize = m_pPlatformSnapshot->getViewPortResolution();
+
+        connect(pPlatformInfo, &IPlatformInfo::snapshotChanged, this, &CTracker::onPlatformSnapshotChanged);
     }
 }
 
+CTracker::~CTracker()
+{
+    // Merged events are sent through this tracker, so they have to go before its members do
+    m_pEventCoalescer->flush();
+    delete m_pEventCoalescer;
+    m_pEventCoalescer = Q_NULLPTR;
+}
+
 QString CTracker::getPropertyId()
 {
     return m_propertyId;
@@ -53,67 +93,423 @@ QString CTracker::getValue(QString &key)
 
 void CTracker::setValue(QString &key, QString &value)
 {
+    QMutexLocker locker(&m_commonPayloadMutex);
     if (m_data.contains(key))
     {
         m_data.take(key);
     }
 
     m_data.insert(key, value);
+    m_isCommonPayloadDirty = true;
 }
 
 void CTracker::send(QMap<QString, QString> params)
 {
-    m_pAnalyticsManager->enqueueHit(addRequiredHitData(params));
+    if (!isSampled())
+    {
+        return;
+    }
+
+    sendSampled(CHitParameters::fromMap(params), EHitPriority_Default);
+}
+
+void CTracker::send(const CHitParameters &params, EHitPriority priority)
+{
+    // Decide before anything is encoded, so hits of clients outside the sample cost nothing
+    if (!isSampled())
+    {
+        return;
+    }
+
+    sendSampled(params, priority);
+}
+
+void CTracker::sendSampled(const CHitParameters &params, EHitPriority priority)
+{
+    QDateTime timeStamp = QDateTime::currentDateTime();
+    if ((priority != EHitPriority_Default) || !m_pEventCoalescer->add(params, timeStamp))
+    {
+        enqueueLimited(params, timeStamp, THitCompletionPtr(), priority);
+    }
 }
 
-void CTracker::onViewPortResolutionChanged()
+QFuture<EHitDeliveryResult> CTracker::sendAsync(const CHitParameters &params, EHitPriority priority)
 {
-    ViewportSize = m_pPlatformInfo->getViewPortResolution();
+    if (!isSampled())
+    {
+        return CHitCompletion::completed(EHitDeliveryResult_Filtered);
+    }
+
+    // A merged hit has no single fate to report, so tracked hits skip the coalescer
+    THitCompletionPtr pCompletion(new CHitCompletion());
+    QFuture<EHitDeliveryResult> future = pCompletion->future();
+    enqueueLimited(params, QDateTime::currentDateTime(), pCompletion, priority);
+
+    return future;
 }
 
-void CTracker::onScreenResolutionChanged()
+CEventCoalescer* CTracker::eventCoalescer()
 {
-    ScreenResolution = m_pPlatformInfo->getScreenResolution();
+    return m_pEventCoalescer;
 }
 
-QMap<QString, QString> CTracker::addRequiredHitData(QMap<QString, QString> &params)
+void CTracker::flush()
 {
-    QMap<QString, QString> result;
+    // Summaries become hits which may be merged or held back, so they go first
+    QMutexLocker aggregatorsLocker(&m_timingAggregatorsMutex);
+    QList<QPointer<CTimingAggregator>> timingAggregators = m_timingAggregators;
+    aggregatorsLocker.unlock();
 
-    result.insert("v", "1");
-    result.insert("tid", getPropertyId());
-    result.insert("cid", ClientId);
-    result.insert("an", AppName);
-    result.insert("av", AppVersion);
+    for (QList<QPointer<CTimingAggregator>>::const_iterator it = timingAggregators.constBegin(), end = timingAggregators.constEnd(); it != end; ++it)
+    {
+        if (*it)
+        {
+            (*it)->flush();
+        }
+    }
 
-    if (!AppId.isEmpty()) result.insert("aid", AppId);
-    if (!AppInstallerId.isEmpty()) result.insert("aiid", AppInstallerId);
-    if (!ScreenName.isEmpty()) result.insert("cd", ScreenName);
+    m_pEventCoalescer->flush();
 
-    if (AnonymizeIP) result.insert("aip", "1");
+    QMutexLocker locker(&m_shapedHitsMutex);
+    QList<SShapedHit> hits;
+    while (!m_shapedHits.isEmpty())
+    {
+        hits.append(m_shapedHits.dequeue());
+    }
+    locker.unlock();
 
-    if (!qFuzzyCompare(ScreenResolution.Width, 0) && !qFuzzyCompare(ScreenResolution.Height, 0))
-        result.insert("sr", QString("%1x%2").arg(ScreenResolution.Width).arg(ScreenResolution.Height));
-    if (!qFuzzyCompare(ViewportSize.Width, 0) && !qFuzzyCompare(ViewportSize.Height, 0))
-        result.insert("vp", QString("%1x%2").arg(ViewportSize.Width).arg(ViewportSize.Height));
-    if (ScreenColors) result.insert("sd", QString("%1-bits").arg(ScreenColors));
+    for (QList<SShapedHit>::const_iterator it = hits.constBegin(), end = hits.constEnd(); it != end; ++it)
+    {
+        enqueue(it->Params, it->TimeStamp, it->Completion, it->Priority);
+    }
+}
 
-    if (!Language.isEmpty()) result.insert("ul", Language);
-    if (!Encoding.isEmpty()) result.insert("de", Encoding);
+void CTracker::addTimingAggregator(CTimingAggregator* pTimingAggregator)
+{
+    QMutexLocker locker(&m_timingAggregatorsMutex);
+    m_timingAggregators.removeAll(QPointer<CTimingAggregator>());
+    m_timingAggregators.append(pTimingAggregator);
+}
 
-    if (!IpOverride.isEmpty()) result.insert("uip", IpOverride);
-    if (!UserAgentOverride.isEmpty()) result.insert("ua", UserAgentOverride);
-    if (!LocationOverride.isEmpty()) result.insert("geoid", LocationOverride);
+quint64 CTracker::delayedHits() const
+{
+    return m_delayedHits.loadAcquire();
+}
+
+quint64 CTracker::shedHits() const
+{
+    return m_shedHits.loadAcquire();
+}
+
+void CTracker::setCrashRecording(bool value)
+{
+    QMutexLocker locker(&m_commonPayloadMutex);
+    m_isCrashRecording = value;
+
+    if (!m_isCrashRecording)
+    {
+        CCrashRecorder::setPayload(QByteArray());
+    }
+    else if (m_isCommonPayloadDirty || !isCommonPayloadValid())
+    {
+        updateCommonPayload();
+    }
+    else
+    {
+        updateCrashPayload();
+    }
+}
+
+void CTracker::enqueueLimited(const CHitParameters &params, const QDateTime &timeStamp, const THitCompletionPtr &pCompletion, EHitPriority priority)
+{
+    m_rateLimiter.setRate(RateLimitBurst, RateLimitRefill);
+
+    // Critical hits are rare and often sent right before the application dies, they never wait
+    quint8 hitType = CHitSchema::hitTypeMask(params.value(EHitParameter_HitType));
+    if (CHit::resolvePriority(hitType, priority) == EHitPriority_Critical)
+    {
+        m_rateLimiter.tryTake();
+        enqueue(params, timeStamp, pCompletion, priority);
+        return;
+    }
+
+    // Hits already waiting go first, so the order is kept
+    QMutexLocker locker(&m_shapedHitsMutex);
+    if (m_shapedHits.isEmpty() && m_rateLimiter.tryTake())
+    {
+        locker.unlock();
+        enqueue(params, timeStamp, pCompletion, priority);
+        return;
+    }
+
+    if ((RateLimitPolicy == CTokenBucket::EPolicy_Shed) || (m_shapedHits.size() >= m_maxShapedHits))
+    {
+        m_shedHits.fetchAndAddRelaxed(1);
+        locker.unlock();
+
+        if (pCompletion)
+        {
+            pCompletion->complete(EHitDeliveryResult_Filtered);
+        }
+        return;
+    }
+
+    SShapedHit shapedHit = { params, timeStamp, pCompletion, priority };
+    m_shapedHits.enqueue(shapedHit);
+    m_delayedHits.fetchAndAddRelaxed(1);
+    locker.unlock();
+
+    // Timers can only be started from the thread of the tracker
+    if (m_isShapePending.testAndSetOrdered(0, 1))
+    {
+        QMetaObject::invokeMethod(this, "onSendShapedHits", Qt::QueuedConnection);
+    }
+}
+
+void CTracker::onSendShapedHits()
+{
+    m_isShapePending.storeRelease(0);
+    m_rateLimiter.setRate(RateLimitBurst, RateLimitRefill);
+
+    QList<SShapedHit> hits;
+
+    QMutexLocker locker(&m_shapedHitsMutex);
+    while (!m_shapedHits.isEmpty() && m_rateLimiter.tryTake())
+    {
+        hits.append(m_shapedHits.dequeue());
+    }
+
+    if (!m_shapedHits.isEmpty())
+    {
+        m_pShapeTimer->start(qMax(m_rateLimiter.waitTime(), 1));
+    }
+    locker.unlock();
+
+    for (QList<SShapedHit>::const_iterator it = hits.constBegin(), end = hits.constEnd(); it != end; ++it)
+    {
+        enqueue(it->Params, it->TimeStamp, it->Completion, it->Priority);
+    }
+}
+
+void CTracker::enqueue(const CHitParameters &params, const QDateTime &timeStamp, const THitCompletionPtr &pCompletion, EHitPriority priority)
+{
+    CHit hit(addRequiredHitData(params), timeStamp);
+    hit.setCompletion(pCompletion);
+
+    if (priority != EHitPriority_Default)
+    {
+        hit.setPriority(priority);
+    }
+
+    m_pAnalyticsManager->enqueueHit(hit);
+}
+
+void CTracker::onPlatformSnapshotChanged()
+{
+    QMutexLocker locker(&m_commonPayloadMutex);
+    m_pPlatformSnapshot = m_pPlatformInfo->getSnapshot();
+    ScreenResolution = m_pPlatformSnapshot->getScreenResolution();
+    ViewportSize = m_pPlatformSnapshot->getViewPortResolution();
+    m_isCommonPayloadDirty = true;
+}
+
+bool CTracker::isSampled()
+{
+    double sampleRate = SampleRate;
+    if (AdaptiveSampling)
+    {
+        sampleRate = sampleRate * m_pAnalyticsManager->adaptiveSampleFactor() / 1000.0;
+    }
+
+    if (sampleRate >= 100.0)
+    {
+        return true;
+    }
+
+    if (sampleRate <= 0.0)
+    {
+        return false;
+    }
+
+    // Clients in a lower rate are a subset of the clients in a higher rate
+    return clientSampleBucket() < static_cast<int>(sampleRate * 100.0);
+}
+
+int CTracker::clientSampleBucket()
+{
+    QMutexLocker locker(&m_sampleMutex);
+    if (ClientId != m_sampleClientId)
+    {
+        // FNV-1a, unlike qHash it is stable across processes and Qt versions
+        quint32 hash = 2166136261u;
+        QByteArray clientId = ClientId.toUtf8();
+        for (int i = 0; i < clientId.size(); i++)
+        {
+            hash ^= static_cast<quint8>(clientId.at(i));
+            hash *= 16777619u;
+        }
+
+        m_sampleClientId = ClientId;
+        m_sampleBucket = static_cast<int>(hash % 10000);
+    }
+
+    return m_sampleBucket;
+}
+
+QByteArray CTracker::addRequiredHitData(const CHitParameters &params)
+{
+    QByteArray payload;
+
+    QMutexLocker locker(&m_commonPayloadMutex);
+    if (m_isCommonPayloadDirty || !isCommonPayloadValid())
+    {
+        updateCommonPayload();
+    }
+
+    // Values of the hit take precedence over the common ones
+    quint64 overriddenIds = 0;
+    for (int i = 0; i < params.size(); i++)
+    {
+        overriddenIds |= (Q_UINT64_C(1) << params.idAt(i)) & m_commonIds;
+    }
+
+    payload.reserve(m_commonPayload.size() + 128);
+    if (overriddenIds == 0)
+    {
+        payload.append(m_commonPayload);
+    }
+    else
+    {
+        for (QVector<SCommonParameter>::const_iterator it = m_commonParameters.constBegin(), end = m_commonParameters.constEnd(); it != end; ++it)
+        {
+            // Indexed and custom parameters share their id, only those need the exact lookup
+            bool isOverridden = (overriddenIds & (Q_UINT64_C(1) << it->Id))
+                && ((it->Id == EHitParameter_Custom) ? params.contains(it->Key) : params.contains(it->Id, it->Index));
+            if (!isOverridden)
+            {
+                if (!payload.isEmpty()) payload.append('&');
+                payload.append(it->Parameter);
+            }
+        }
+    }
+    locker.unlock();
+
+    params.encode(payload);
+
+    return payload;
+}
+
+bool CTracker::isCommonPayloadValid() const
+{
+    // The properties are plain members, so check them against the copies the payload was built from.
+    // A copy shares the data of its string, any assignment or modification since detaches it, so
+    // comparing the data pointers finds every change without comparing characters.
+    return (AnonymizeIP == m_commonAnonymizeIP)
+        && ClientId.isSharedWith(m_commonClientId)
+        && IpOverride.isSharedWith(m_commonIpOverride)
+        && UserAgentOverride.isSharedWith(m_commonUserAgentOverride)
+        && LocationOverride.isSharedWith(m_commonLocationOverride)
+        && qFuzzyCompare(ScreenResolution.Width, m_commonScreenResolution.Width)
+        && qFuzzyCompare(ScreenResolution.Height, m_commonScreenResolution.Height)
+        && qFuzzyCompare(ViewportSize.Width, m_commonViewportSize.Width)
+        && qFuzzyCompare(ViewportSize.Height, m_commonViewportSize.Height)
+        && Encoding.isSharedWith(m_commonEncoding)
+        && (ScreenColors == m_commonScreenColors)
+        && Language.isSharedWith(m_commonLanguage)
+        && ScreenName.isSharedWith(m_commonScreenName)
+        && AppName.isSharedWith(m_commonAppName)
+        && AppId.isSharedWith(m_commonAppId)
+        && AppVersion.isSharedWith(m_commonAppVersion)
+        && AppInstallerId.isSharedWith(m_commonAppInstallerId);
+}
+
+void CTracker::updateCommonPayload()
+{
+    m_commonAnonymizeIP = AnonymizeIP;
+    m_commonClientId = ClientId;
+    m_commonIpOverride = IpOverride;
+    m_commonUserAgentOverride = UserAgentOverride;
+    m_commonLocationOverride = LocationOverride;
+    m_commonScreenResolution = ScreenResolution;
+    m_commonViewportSize = ViewportSize;
+    m_commonEncoding = Encoding;
+    m_commonScreenColors = ScreenColors;
+    m_commonLanguage = Language;
+    m_commonScreenName = ScreenName;
+    m_commonAppName = AppName;
+    m_commonAppId = AppId;
+    m_commonAppVersion = AppVersion;
+    m_commonAppInstallerId = AppInstallerId;
+
+    CHitParameters result;
+
+    result.insert(EHitParameter_ProtocolVersion, "1");
+    result.insert(EHitParameter_TrackingId, getPropertyId());
+    result.insert(EHitParameter_ClientId, ClientId);
+    result.insert(EHitParameter_ApplicationName, AppName);
+    result.insert(EHitParameter_ApplicationVersion, AppVersion);
+
+    if (!AppId.isEmpty()) result.insert(EHitParameter_ApplicationId, AppId);
+    if (!AppInstallerId.isEmpty()) result.insert(EHitParameter_ApplicationInstallerId, AppInstallerId);
+    if (!ScreenName.isEmpty()) result.insert(EHitParameter_ScreenName, ScreenName);
+
+    if (AnonymizeIP) result.insert(EHitParameter_AnonymizeIp, "1");
+
+    // The snapshot has the sizes of the platform formatted already, only overridden ones are formatted here
+    QString screenResolution = (m_pPlatformSnapshot && !(ScreenResolution != m_pPlatformSnapshot->getScreenResolution())) ? m_pPlatformSnapshot->getScreenResolutionString() : CPlatformSnapshot::formatDimensions(ScreenResolution);
+    QString viewportSize = (m_pPlatformSnapshot && !(ViewportSize != m_pPlatformSnapshot->getViewPortResolution())) ? m_pPlatformSnapshot->getViewPortResolutionString() : CPlatformSnapshot::formatDimensions(ViewportSize);
+    if (!screenResolution.isEmpty()) result.insert(EHitParameter_ScreenResolution, screenResolution);
+    if (!viewportSize.isEmpty()) result.insert(EHitParameter_ViewportSize, viewportSize);
+    if (ScreenColors) result.insert(EHitParameter_ScreenColors, QString("%1-bits").arg(ScreenColors));
+
+    if (!Language.isEmpty()) result.insert(EHitParameter_UserLanguage, Language);
+    if (!Encoding.isEmpty()) result.insert(EHitParameter_DocumentEncoding, Encoding);
+
+    if (!IpOverride.isEmpty()) result.insert(EHitParameter_IpOverride, IpOverride);
+    if (!UserAgentOverride.isEmpty()) result.insert(EHitParameter_UserAgentOverride, UserAgentOverride);
+    if (!LocationOverride.isEmpty()) result.insert(EHitParameter_GeographicalOverride, LocationOverride);
 
     for(QMap<QString, QString>::const_iterator it = m_data.begin(), end = m_data.end(); it != end; ++it)
     {
         result.insert(it.key(), it.value());
     }
 
-    for(QMap<QString, QString>::const_iterator it = params.begin(), end = params.end(); it != end; ++it)
+    // Encode every parameter once
+    m_commonParameters.clear();
+    m_commonIds = 0;
+    m_commonPayload.clear();
+    for (int i = 0; i < result.size(); i++)
     {
-        result.insert(it.key(), it.value());
+        SCommonParameter parameter;
+        parameter.Id = result.idAt(i);
+        parameter.Index = result.parameterIndexAt(i);
+        if (parameter.Id == EHitParameter_Custom) parameter.Key = result.keyAt(i);
+        result.encodeAt(i, parameter.Parameter);
+
+        m_commonParameters.append(parameter);
+        m_commonIds |= Q_UINT64_C(1) << parameter.Id;
+
+        if (!m_commonPayload.isEmpty()) m_commonPayload.append('&');
+        m_commonPayload.append(parameter.Parameter);
+    }
+
+    m_isCommonPayloadDirty = false;
+
+    if (m_isCrashRecording)
+    {
+        updateCrashPayload();
     }
+}
+
+void CTracker::updateCrashPayload()
+{
+    // The signal handler only appends the description, everything else is encoded now
+    CHitParameters crashParams;
+    crashParams.insert(EHitParameter_HitType, "exception");
+    crashParams.insert(EHitParameter_ExceptionFatal, "1");
+
+    QByteArray payload = m_commonPayload;
+    crashParams.encode(payload);
 
-    return result;
+    CCrashRecorder::setPayload(payload);
 }
@@ -24,12 +24,25 @@
 
 #include "ianalyticsmanager.h"
 #include "iplatforminfo.h"
+#include "eventcoalescer.h"
 #include "hit.h"
+#include "hitparameters.h"
+#include "tokenbucket.h"
 
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QFuture>
 #include <QMap>
+#include <QMutex>
+#include <QPointer>
+#include <QQueue>
+#include <QTimer>
+#include <QVector>
 
 QTANALYTICS_NAMESPACE_BEGIN
 
+class CTimingAggregator;
+
 class CTracker : public QObject
 {
     Q_OBJECT
@@ -55,8 +68,18 @@ class CTracker : public QObject
     Q_PROPERTY(QString appVersion MEMBER AppVersion)
     Q_PROPERTY(QString appInstallerId MEMBER AppInstallerId)
 
+    Q_PROPERTY(double sampleRate MEMBER SampleRate)
+    Q_PROPERTY(bool adaptiveSampling MEMBER AdaptiveSampling)
+
+    Q_PROPERTY(int rateLimitBurst MEMBER RateLimitBurst)
+    Q_PROPERTY(double rateLimitRefill MEMBER RateLimitRefill)
+    Q_PROPERTY(CTokenBucket::EPolicy rateLimitPolicy MEMBER RateLimitPolicy)
+    Q_PROPERTY(quint64 delayedHits READ delayedHits)
+    Q_PROPERTY(quint64 shedHits READ shedHits)
+
 public:
     CTracker(QString& propertyId, IPlatformInfo* pPlatformInfo, IAnalyticsManager* pAnalyticsManager);
+    virtual ~CTracker();
 
     /// <summary>
     /// Gets or sets the tracking ID / web property ID. The format is UA-XXXX-Y. All collected data is associated by this ID.
@@ -83,9 +106,58 @@ public:
     /// Merges the model values set on this Tracker with params and generates a hit to be sent.
     /// </summary>
     /// <param name="params">Dictionary of hit data to values which are merged with the existing values which are already set (using Set(String, String)). Values in this dictionary will override the values set earlier. The values in this dictionary will not be reused for the subsequent hits. If you need to send a value in multiple hits, you can use the Set(String, String) method.</param>
-    /// <remarks>The hit may not be dispatched immediately.</remarks>
+    /// <remarks>The hit may not be dispatched immediately. May be called from any thread.</remarks>
     void send(QMap<QString, QString> params);
 
+    /// <summary>
+    /// Merges the model values set on this Tracker with the parameters created by <see cref="CHitBuilder"/> and generates a hit to be sent.
+    /// </summary>
+    /// <param name="params">Parameters of the hit, they override the values set earlier.</param>
+    /// <param name="priority">Dispatch lane of the hit, by default derived from the hit type. Hits with an explicit lane are never merged by the event coalescer.</param>
+    /// <remarks>The hit may not be dispatched immediately. May be called from any thread.</remarks>
+    void send(const CHitParameters &params, EHitPriority priority = EHitPriority_Default);
+
+    /// <summary>
+    /// Sends a hit like <see cref="send"/> and returns a future which resolves when the fate of the hit is known.
+    /// </summary>
+    /// <param name="params">Parameters of the hit, they override the values set earlier.</param>
+    /// <param name="priority">Dispatch lane of the hit, by default derived from the hit type.</param>
+    /// <returns>Future of the delivery result. Tracked hits are never merged by the event coalescer.</returns>
+    /// <remarks>Hits sent without a future carry no tracking state. May be called from any thread.</remarks>
+    QFuture<EHitDeliveryResult> sendAsync(const CHitParameters &params, EHitPriority priority = EHitPriority_Default);
+
+    /// <summary>
+    /// Gets the stage which merges repeated events before they are queued. It is disabled by default.
+    /// </summary>
+    CEventCoalescer* eventCoalescer();
+
+    /// <summary>
+    /// Hands every hit this tracker still holds to the dispatcher: the summaries of its timing aggregators, pending merged events and hits waiting for the rate limit.
+    /// </summary>
+    /// <remarks>Called by <see cref="CAnalyticsManager::flush"/>. Hits waiting for the rate limit are not held back any longer. May be called from any thread.</remarks>
+    void flush();
+
+    /// <summary>
+    /// Registers an aggregator whose summaries are sent by <see cref="flush"/>. Called by <see cref="CTimingAggregator"/>.
+    /// </summary>
+    void addTimingAggregator(CTimingAggregator* pTimingAggregator);
+
+    /// <summary>
+    /// Gets the number of hits which were held back by the rate limit of this tracker.
+    /// </summary>
+    quint64 delayedHits() const;
+
+    /// <summary>
+    /// Gets the number of hits which were discarded by the rate limit of this tracker.
+    /// </summary>
+    quint64 shedHits() const;
+
+    /// <summary>
+    /// Sets whether the common values of this tracker are kept in the <see cref="CCrashRecorder"/>, so a crash is reported as a fatal exception.
+    /// </summary>
+    /// <remarks>Set by <see cref="CAnalyticsManager"/> for the default tracker when a crash file is set.</remarks>
+    void setCrashRecording(bool value);
+
     /// <summary>
     /// Gets or sets whether the IP address of the sender will be anonymized.
     /// </summary>
@@ -196,18 +268,122 @@ public:
     /// <seealso href="https://developers.google.com/analytics/devguides/collection/protocol/v1/parameters#aiid"/>
     QString AppInstallerId;
 
+    /// <summary>
+    /// Gets or sets the percentage of clients whose hits are sent. Clients are selected by a hash of <see cref="ClientId"/>, so a client is either always or never sampled.
+    /// </summary>
+    /// <remarks>Optional. Default is 100.</remarks>
+    double SampleRate;
+
+    /// <summary>
+    /// Gets or sets whether the sample rate is lowered further while the hit queue is long or sending is slow.
+    /// </summary>
+    /// <remarks>Optional. Default is false. The thresholds are set on the analytics manager.</remarks>
+    bool AdaptiveSampling;
+
+    /// <summary>
+    /// Gets or sets the number of hits which may be sent at once before the rate limit applies.
+    /// </summary>
+    /// <remarks>Optional. Default is 20, the quota of analytics.js. Values below 1 are raised to 1.</remarks>
+    int RateLimitBurst;
+
+    /// <summary>
+    /// Gets or sets the number of hits per second the rate limit allows after a burst, 0 for no limit.
+    /// </summary>
+    /// <remarks>Optional. Default is 2, the quota of analytics.js. Unlike the limit of the analytics manager, which is off by default, every tracker keeps to the per-property quota of Google Analytics unless this is set to 0.</remarks>
+    double RateLimitRefill;
+
+    /// <summary>
+    /// Gets or sets whether hits over the rate limit are delayed or discarded.
+    /// </summary>
+    /// <remarks>Optional. Default is <see cref="CTokenBucket::EPolicy_Shape"/>.</remarks>
+    CTokenBucket::EPolicy RateLimitPolicy;
+
 private slots:
-    void onViewPortResolutionChanged();
-    void onScreenResolutionChanged();
+    void onPlatformSnapshotChanged();
+    void onSendShapedHits();
 
 private:
-    QMap<QString, QString> addRequiredHitData(QMap<QString, QString> &params);
+    bool isSampled();
+    void sendSampled(const CHitParameters &params, EHitPriority priority);
+    int clientSampleBucket();
+
+    void enqueue(const CHitParameters &params, const QDateTime &timeStamp, const THitCompletionPtr &pCompletion = THitCompletionPtr(), EHitPriority priority = EHitPriority_Default);
+    void enqueueLimited(const CHitParameters &params, const QDateTime &timeStamp, const THitCompletionPtr &pCompletion = THitCompletionPtr(), EHitPriority priority = EHitPriority_Default);
+    QByteArray addRequiredHitData(const CHitParameters &params);
+
+    bool isCommonPayloadValid() const;
+    void updateCommonPayload();
+    void updateCrashPayload();
 
     IAnalyticsManager* m_pAnalyticsManager;
     IPlatformInfo* m_pPlatformInfo;
+    TPlatformSnapshotPtr m_pPlatformSnapshot;
 
     QMap<QString, QString> m_data;
     QString m_propertyId;
+
+    CEventCoalescer* m_pEventCoalescer;
+
+    // Aggregators are owned by the application, destroyed ones drop out of the list by themselves
+    QMutex m_timingAggregatorsMutex;
+    QList<QPointer<CTimingAggregator>> m_timingAggregators;
+
+    struct SShapedHit
+    {
+        CHitParameters Params;
+        QDateTime TimeStamp;
+        THitCompletionPtr Completion;
+        EHitPriority Priority;
+    };
+
+    // Hits held back by the rate limit, sent in order by a timer of the tracker thread
+    CTokenBucket m_rateLimiter;
+    QMutex m_shapedHitsMutex;
+    QQueue<SShapedHit> m_shapedHits;
+    QTimer* m_pShapeTimer;
+    QAtomicInt m_isShapePending;
+    QAtomicInteger<quint64> m_delayedHits;
+    QAtomicInteger<quint64> m_shedHits;
+
+    static const int m_maxShapedHits;
+
+    // Sample bucket of the client, recomputed when the client id changes
+    QMutex m_sampleMutex;
+    QString m_sampleClientId;
+    int m_sampleBucket;
+
+    struct SCommonParameter
+    {
+        EHitParameter Id;
+        int Index;
+        QString Key;
+        QByteArray Parameter;
+    };
+
+    // Encoded parameters shared by all hits, rebuilt when one of the values below changes.
+    // The mask has a bit per schema id, so most hits find their overrides without a lookup.
+    QMutex m_commonPayloadMutex;
+    QVector<SCommonParameter> m_commonParameters;
+    quint64 m_commonIds;
+    QByteArray m_commonPayload;
+    bool m_isCommonPayloadDirty;
+    bool m_isCrashRecording;
+
+    bool m_commonAnonymizeIP;
+    QString m_commonClientId;
+    QString m_commonIpOverride;
+    QString m_commonUserAgentOverride;
+    QString m_commonLocationOverride;
+    Dimensions m_commonScreenResolution;
+    Dimensions m_commonViewportSize;
+    QString m_commonEncoding;
+    int m_commonScreenColors;
+    QString m_commonLanguage;
+    QString m_commonScreenName;
+    QString m_commonAppName;
+    QString m_commonAppId;
+    QString m_commonAppVersion;
+    QString m_commonAppInstallerId;
 };
 
 QTANALYTICS_NAMESPACE_END
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "tsthitjournal.h"
+#include "hitjournal.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtTest>
+
+QTANALYTICS_NAMESPACE_USING
+
+namespace
+{
+    CHit createHit(int index)
+    {
+        QByteArray payload = QString("v=1&t=event&ec=journal&ea=record%1").arg(index).toLatin1();
+        return CHit(payload, QDateTime::fromMSecsSinceEpoch(Q_INT64_C(1546300800000) + index));
+    }
+
+    quint64 appendHit(CHitJournal &journal, int index)
+    {
+        return journal.append(createHit(index));
+    }
+
+    void acknowledgeHit(CHitJournal &journal, int index, quint64 id)
+    {
+        CHit hit = createHit(index);
+        hit.setJournalId(id);
+        journal.acknowledge(hit);
+    }
+}
+
+void CHitJournalTest::recoversPendingHits()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QString fileName = directory.filePath("hits.journal");
+
+    {
+        CHitJournal journal;
+        QVERIFY(journal.open(fileName));
+        QVERIFY(journal.takeRecoveredHits().isEmpty());
+
+        QVERIFY(appendHit(journal, 1) != 0);
+        quint64 acknowledgedId = appendHit(journal, 2);
+        QVERIFY(acknowledgedId != 0);
+        QVERIFY(appendHit(journal, 3) != 0);
+
+        acknowledgeHit(journal, 2, acknowledgedId);
+        journal.close();
+    }
+
+    CHitJournal journal;
+    QVERIFY(journal.open(fileName));
+
+    QList<CHit> hits = journal.takeRecoveredHits();
+    QCOMPARE(hits.size(), 2);
+    QCOMPARE(hits.at(0).getPayload(), createHit(1).getPayload());
+    QCOMPARE(hits.at(0).getTimeStamp(), createHit(1).getTimeStamp());
+    QCOMPARE(hits.at(1).getPayload(), createHit(3).getPayload());
+    QCOMPARE(hits.at(1).getTimeStamp(), createHit(3).getTimeStamp());
+    QVERIFY(hits.at(0).getJournalId() != 0);
+    QVERIFY(hits.at(0).getJournalId() != hits.at(1).getJournalId());
+
+    // Recovered hits are handed out once
+    QVERIFY(journal.takeRecoveredHits().isEmpty());
+}
+
+void CHitJournalTest::stopsAtCorruptedRecord()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QString fileName = directory.filePath("hits.journal");
+
+    {
+        CHitJournal journal;
+        QVERIFY(journal.open(fileName));
+        for (int i = 1; i <= 3; i++)
+        {
+            QVERIFY(appendHit(journal, i) != 0);
+        }
+
+        journal.close();
+    }
+
+    // Damage the payload of the second record, its checksum no longer matches
+    {
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::ReadWrite));
+
+        QByteArray content = file.readAll();
+        int offset = content.indexOf(createHit(2).getPayload());
+        QVERIFY(offset > 0);
+
+        content[offset] = static_cast<char>(content.at(offset) ^ 0x20);
+        QVERIFY(file.seek(0));
+        QCOMPARE(file.write(content), static_cast<qint64>(content.size()));
+    }
+
+    CHitJournal journal;
+    QVERIFY(journal.open(fileName));
+
+    QList<CHit> hits = journal.takeRecoveredHits();
+    QCOMPARE(hits.size(), 1);
+    QCOMPARE(hits.at(0).getPayload(), createHit(1).getPayload());
+
+    // The journal keeps accepting hits behind the last valid record
+    QVERIFY(appendHit(journal, 4) != 0);
+}
+
+void CHitJournalTest::continuesIdsAfterRecovery()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QString fileName = directory.filePath("hits.journal");
+
+    quint64 lastId = 0;
+    {
+        CHitJournal journal;
+        QVERIFY(journal.open(fileName));
+        for (int i = 1; i <= 3; i++)
+        {
+            lastId = appendHit(journal, i);
+        }
+
+        journal.close();
+    }
+
+    CHitJournal journal;
+    QVERIFY(journal.open(fileName));
+    QCOMPARE(journal.takeRecoveredHits().size(), 3);
+    QVERIFY(appendHit(journal, 4) > lastId);
+}
+
+void CHitJournalTest::compactsAcknowledgedRecords()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QString fileName = directory.filePath("hits.journal");
+
+    {
+        CHitJournal journal;
+        QVERIFY(journal.open(fileName));
+        for (int i = 1; i <= 100; i++)
+        {
+            quint64 id = appendHit(journal, i);
+            QVERIFY(id != 0);
+
+            if (i != 50)
+            {
+                acknowledgeHit(journal, i, id);
+            }
+        }
+
+        journal.close();
+    }
+
+    // Reopening drops the acknowledged records, the remaining hit survives the next reopen as well
+    for (int pass = 0; pass < 2; pass++)
+    {
+        CHitJournal journal;
+        QVERIFY(journal.open(fileName));
+
+        QList<CHit> hits = journal.takeRecoveredHits();
+        QCOMPARE(hits.size(), 1);
+        QCOMPARE(hits.at(0).getPayload(), createHit(50).getPayload());
+        QCOMPARE(hits.at(0).getTimeStamp(), createHit(50).getTimeStamp());
+    }
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "tsthitqueue.h"
+#include "hitqueue.h"
+
+#include <QtTest>
+
+QTANALYTICS_NAMESPACE_USING
+
+namespace
+{
+    QDateTime timeAt(int index)
+    {
+        return QDateTime::fromMSecsSinceEpoch(Q_INT64_C(1546300800000) + index);
+    }
+
+    CHit createHit(const QString &hitType, int index)
+    {
+        return CHit(QString("v=1&t=%1&ea=record%2").arg(hitType).arg(index).toLatin1(), timeAt(index));
+    }
+}
+
+void CHitQueueTest::takesOldestAcrossLanes()
+{
+    QList<CHit> hits;
+    hits << createHit("timing", 0) << createHit("event", 1) << createHit("exception", 2) << createHit("timing", 3);
+
+    CHitQueue queue;
+    queue.append(hits.at(1));
+    queue.append(hits.at(2));
+    queue.append(hits.at(3));
+    queue.prepend(hits.at(0));
+
+    qint64 bytes = 0;
+    for (const CHit &hit : hits)
+    {
+        bytes += hit.getPayload().size();
+    }
+
+    QCOMPARE(queue.size(), 4);
+    QCOMPARE(queue.bytes(), bytes);
+
+    // Lanes only change the order of sending, overflow removes hits in the order they were queued
+    for (int i = 0; i < 4; i++)
+    {
+        QCOMPARE(queue.takeOldest().getPayload(), hits.at(i).getPayload());
+    }
+
+    QVERIFY(queue.isEmpty());
+    QCOMPARE(queue.bytes(), Q_INT64_C(0));
+}
+
+void CHitQueueTest::takesLowestDropPriorityFirst()
+{
+    CHitQueue queue;
+    queue.append(createHit("exception", 1));
+    queue.append(createHit("pageview", 2));
+    queue.append(createHit("timing", 3));
+    queue.append(createHit("event", 4));
+    queue.append(createHit("timing", 5));
+
+    QCOMPARE(queue.lowestPriority(), CHitQueue::dropPriority(createHit("timing", 0)));
+
+    // Timings go first, then page views, events and exceptions, the oldest of each first
+    const char* expectedTypes[] = { "timing", "timing", "pageview", "event", "exception" };
+    const int expectedIndexes[] = { 3, 5, 2, 4, 1 };
+    for (int i = 0; i < 5; i++)
+    {
+        CHit hit = queue.takeLowestPriority();
+        QCOMPARE(hit.getPayload(), createHit(expectedTypes[i], expectedIndexes[i]).getPayload());
+    }
+
+    QVERIFY(queue.isEmpty());
+}
+
+void CHitQueueTest::takesExpiredHits()
+{
+    CHitQueue queue;
+    for (int i = 0; i < 6; i++)
+    {
+        queue.append(createHit((i % 2) ? "event" : "timing", i));
+    }
+
+    QList<CHit> expiredHits = queue.takeExpired(timeAt(3));
+    QCOMPARE(expiredHits.size(), 3);
+    QCOMPARE(queue.size(), 3);
+
+    for (const CHit &hit : expiredHits)
+    {
+        QVERIFY(hit.getTimeStamp() < timeAt(3));
+    }
+
+    while (!queue.isEmpty())
+    {
+        QVERIFY(queue.dequeue().getTimeStamp() >= timeAt(3));
+    }
+}
+
+void CHitQueueTest::servesLanesByWeight()
+{
+    CHitQueue queue;
+    for (int i = 0; i < 100; i++)
+    {
+        queue.append(createHit("exception", i));
+        queue.append(createHit("event", i));
+        queue.append(createHit("timing", i));
+    }
+
+    // While every lane is waiting, each round of the weights serves the lanes in proportion to them
+    int roundSize = 0;
+    for (int lane = 0; lane < EHitPriority_Count; lane++)
+    {
+        roundSize += CHitQueue::laneWeight(lane);
+    }
+
+    int servedCounts[EHitPriority_Count] = { 0 };
+    int nextIndexes[EHitPriority_Count] = { 0 };
+    for (int i = 0; i < 3 * roundSize; i++)
+    {
+        QByteArray headPayload = queue.head().getPayload();
+        CHit hit = queue.dequeue();
+        QCOMPARE(hit.getPayload(), headPayload);
+
+        // Every lane stays in the order its hits were queued
+        int lane = hit.getPriority();
+        QCOMPARE(hit.getTimeStamp(), timeAt(nextIndexes[lane]++));
+        servedCounts[lane]++;
+    }
+
+    for (int lane = 0; lane < EHitPriority_Count; lane++)
+    {
+        QCOMPARE(servedCounts[lane], 3 * CHitQueue::laneWeight(lane));
+    }
+}
+
+void CHitQueueTest::servesSingleLaneInOrder()
+{
+    CHitQueue queue;
+    for (int i = 0; i < 10; i++)
+    {
+        queue.append(createHit("timing", i));
+    }
+
+    // A lane which waits alone is not held back by its weight
+    for (int i = 0; i < 10; i++)
+    {
+        QCOMPARE(queue.head().getTimeStamp(), timeAt(i));
+        QCOMPARE(queue.dequeue().getTimeStamp(), timeAt(i));
+    }
+
+    QVERIFY(queue.isEmpty());
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "tstsharedhitring.h"
+#include "sharedhitring.h"
+
+#include <QCoreApplication>
+#include <QtTest>
+
+QTANALYTICS_NAMESPACE_USING
+
+namespace
+{
+    CHit createHit(int index, int padding = 0)
+    {
+        QByteArray payload = QString("v=1&t=event&ec=ring&ea=record%1").arg(index).toLatin1();
+        payload.append(QByteArray(padding, 'x'));
+
+        return CHit(payload, QDateTime::fromMSecsSinceEpoch(Q_INT64_C(1546300800000) + index));
+    }
+}
+
+CSharedHitRingTest::CSharedHitRingTest()
+    : m_keyIndex(0)
+{
+}
+
+QString CSharedHitRingTest::nextKey()
+{
+    // Every test gets its own segment, a ring left behind by another run must not be reused
+    return QString("qtanalytics-test-%1-%2").arg(QCoreApplication::applicationPid()).arg(++m_keyIndex);
+}
+
+void CSharedHitRingTest::pushAndPopKeepHits()
+{
+    CSharedHitRing ring;
+    QVERIFY(ring.attach(nextKey(), 4096));
+
+    CHit bulkHit = createHit(2);
+    bulkHit.setPriority(EHitPriority_Bulk);
+
+    QVERIFY(ring.push(createHit(1)));
+    QVERIFY(ring.push(bulkHit));
+
+    QList<CHit> hits;
+    QCOMPARE(ring.pop(hits, 10), 2);
+    QCOMPARE(hits.at(0).getPayload(), createHit(1).getPayload());
+    QCOMPARE(hits.at(0).getTimeStamp(), createHit(1).getTimeStamp());
+    QCOMPARE(hits.at(0).getPriority(), EHitPriority_Normal);
+    QCOMPARE(hits.at(1).getPayload(), bulkHit.getPayload());
+    QCOMPARE(hits.at(1).getPriority(), EHitPriority_Bulk);
+
+    // Popped records are gone
+    QCOMPARE(ring.pop(hits, 10), 0);
+    QCOMPARE(hits.size(), 2);
+}
+
+void CSharedHitRingTest::attachKeepsQueuedRecords()
+{
+    QString key = nextKey();
+
+    CSharedHitRing producer;
+    QVERIFY(producer.attach(key, 4096));
+    QVERIFY(producer.push(createHit(1)));
+
+    // A second process attaching to the ring must not initialize it again
+    CSharedHitRing consumer;
+    QVERIFY(consumer.attach(key, 4096));
+    QVERIFY(consumer.push(createHit(2)));
+
+    QList<CHit> hits;
+    QCOMPARE(consumer.pop(hits, 1), 1);
+    QCOMPARE(hits.at(0).getPayload(), createHit(1).getPayload());
+
+    QCOMPARE(producer.pop(hits, 10), 1);
+    QCOMPARE(hits.at(1).getPayload(), createHit(2).getPayload());
+}
+
+void CSharedHitRingTest::rejectsPushWhenFull()
+{
+    CSharedHitRing ring;
+    QVERIFY(ring.attach(nextKey(), 4096));
+
+    // A record may take a quarter of the ring at most
+    QVERIFY(!ring.push(createHit(0, 2048)));
+
+    int pushedCount = 0;
+    while (ring.push(createHit(pushedCount, 200)))
+    {
+        pushedCount++;
+        QVERIFY(pushedCount < 4096);
+    }
+
+    QVERIFY(pushedCount > 0);
+
+    QList<CHit> hits;
+    QCOMPARE(ring.pop(hits, 1), 1);
+    QVERIFY(ring.push(createHit(pushedCount, 200)));
+}
+
+void CSharedHitRingTest::wrapsAroundTheEnd()
+{
+    CSharedHitRing ring;
+    QVERIFY(ring.attach(nextKey(), 4096));
+
+    // Records which do not fit before the end of the ring are padded and start at its beginning
+    QList<CHit> hits;
+    for (int i = 0; i < 20; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            QVERIFY(ring.push(createHit(i * 3 + j, 700)));
+        }
+
+        QCOMPARE(ring.pop(hits, 10), 3);
+    }
+
+    QCOMPARE(hits.size(), 60);
+    for (int i = 0; i < hits.size(); i++)
+    {
+        QCOMPARE(hits.at(i).getPayload(), createHit(i, 700).getPayload());
+        QCOMPARE(hits.at(i).getTimeStamp(), createHit(i, 700).getTimeStamp());
+    }
+}
+
+void CSharedHitRingTest::grantsLeadershipToOneInstance()
+{
+    QString key = nextKey();
+
+    CSharedHitRing first;
+    CSharedHitRing second;
+    QVERIFY(first.attach(key, 4096));
+    QVERIFY(second.attach(key, 4096));
+
+    QVERIFY(first.tryAcquireLeadership());
+    QVERIFY(first.isLeader());
+    QVERIFY(!second.tryAcquireLeadership());
+    QVERIFY(!second.isLeader());
+    QVERIFY(!second.renewLeadership());
+
+    // Detaching hands the lease over without waiting for it to run out
+    first.detach();
+    QVERIFY(second.tryAcquireLeadership());
+    QVERIFY(second.renewLeadership());
+}
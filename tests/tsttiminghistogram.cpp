@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2019 Björn Rennfanz (bjoern@fam-rennfanz.de)
+ *
+ * This file is part of QtAnalytics (https://github.com/bjoernrennfanz/QtAnalytics)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and
+ * to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+ * the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "tsttiminghistogram.h"
+#include "timinghistogram.h"
+
+#include <QtTest>
+
+#include <cmath>
+
+QTANALYTICS_NAMESPACE_USING
+
+namespace
+{
+    // Half the width of a bucket relative to its lower bound, 16 buckets per power of two
+    const double s_maxRelativeError = 1.0 / 32.0;
+
+    bool isWithinBucketError(quint64 value, quint64 expected)
+    {
+        return std::fabs(static_cast<double>(value) - static_cast<double>(expected)) <= expected * s_maxRelativeError + 0.5;
+    }
+}
+
+void CTimingHistogramTest::keepsSmallValuesExact()
+{
+    for (quint64 value = 0; value < 16; value++)
+    {
+        QCOMPARE(CTimingHistogram::bucketValue(CTimingHistogram::bucketOf(value)), value);
+    }
+
+    CTimingHistogram histogram;
+    for (quint64 value = 0; value < 16; value++)
+    {
+        histogram.record(value);
+    }
+
+    QVector<quint64> counts;
+    histogram.takeInto(counts);
+    QCOMPARE(CTimingHistogram::percentile(counts, 16, 0.0), Q_UINT64_C(0));
+    QCOMPARE(CTimingHistogram::percentile(counts, 16, 50.0), Q_UINT64_C(7));
+    QCOMPARE(CTimingHistogram::percentile(counts, 16, 100.0), Q_UINT64_C(15));
+}
+
+void CTimingHistogramTest::boundsBucketError()
+{
+    int lastBucket = 0;
+    for (quint64 value = 16; value < (Q_UINT64_C(1) << 40); value += (value / 7) + 1)
+    {
+        int bucket = CTimingHistogram::bucketOf(value);
+        QVERIFY(bucket >= lastBucket);
+        QVERIFY(bucket < CTimingHistogram::BucketCount);
+        QVERIFY2(isWithinBucketError(CTimingHistogram::bucketValue(bucket), value), qPrintable(QString::number(value)));
+
+        lastBucket = bucket;
+    }
+
+    // Values beyond the range all land in the last bucket
+    QCOMPARE(CTimingHistogram::bucketOf(Q_UINT64_C(1) << 50), CTimingHistogram::BucketCount - 1);
+}
+
+void CTimingHistogramTest::readsPercentiles()
+{
+    CTimingHistogram histogram;
+    const quint64 valueCount = 100000;
+    for (quint64 value = 1; value <= valueCount; value++)
+    {
+        histogram.record(value);
+    }
+
+    QVector<quint64> counts;
+    histogram.copyInto(counts);
+
+    const double percents[] = { 1.0, 25.0, 50.0, 90.0, 99.0, 99.9, 100.0 };
+    for (double percent : percents)
+    {
+        quint64 expected = static_cast<quint64>(std::ceil(percent / 100.0 * valueCount));
+        quint64 value = CTimingHistogram::percentile(counts, valueCount, percent);
+        QVERIFY2(isWithinBucketError(value, expected), qPrintable(QString("p%1 is %2, expected %3").arg(percent).arg(value).arg(expected)));
+    }
+
+    QCOMPARE(CTimingHistogram::percentile(QVector<quint64>(), 0, 50.0), Q_UINT64_C(0));
+}
+
+void CTimingHistogramTest::mergesHistograms()
+{
+    CTimingHistogram first;
+    CTimingHistogram second;
+    CTimingHistogram combined;
+    for (quint64 value = 1; value <= 1000; value++)
+    {
+        (value % 3 ? first : second).record(value * 10);
+        combined.record(value * 10);
+    }
+
+    QVector<quint64> mergedCounts;
+    first.takeInto(mergedCounts);
+    second.takeInto(mergedCounts);
+
+    QVector<quint64> combinedCounts;
+    combined.copyInto(combinedCounts);
+    QCOMPARE(mergedCounts, combinedCounts);
+
+    // Taking resets the histogram, copying does not
+    QVector<quint64> emptyCounts;
+    first.copyInto(emptyCounts);
+    QCOMPARE(emptyCounts, QVector<quint64>(CTimingHistogram::BucketCount, 0));
+
+    QVector<quint64> copiedCounts;
+    combined.copyInto(copiedCounts);
+    QCOMPARE(copiedCounts, combinedCounts);
+}